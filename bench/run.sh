@@ -0,0 +1,43 @@
+#!/bin/sh
+# Run tfwm under Xvfb and write one JSON line per operation to $OUT, truncating
+# it first. HOME and XDG_RUNTIME_DIR point at a scratch directory so the user's
+# config, log, journal and socket are never touched.
+
+DPY=${TFWM_BENCH_DISPLAY:-:99}
+OUT=${TFWM_BENCH_OUT:-bench_output.txt}
+CLIENTS=${TFWM_BENCH_CLIENTS:-"10 100 1000"}
+
+tmp=$(mktemp -d) || exit 1
+xvfb=
+tfwm=
+trap 'kill $tfwm $xvfb 2>/dev/null; rm -rf "$tmp"' EXIT
+trap 'exit 1' INT TERM
+
+HOME=$tmp
+XDG_RUNTIME_DIR=$tmp
+export HOME XDG_RUNTIME_DIR
+
+Xvfb "$DPY" -screen 0 1920x1080x24 -nolisten tcp -displayfd 3 \
+  3>"$tmp/ready" >/dev/null 2>&1 &
+xvfb=$!
+i=0
+while [ ! -s "$tmp/ready" ]; do
+  if ! kill -0 $xvfb 2>/dev/null || [ $i -ge 100 ]; then
+    echo "ERROR: Xvfb did not start on $DPY" >&2
+    exit 1
+  fi
+  i=$((i + 1))
+  sleep 0.1
+done
+
+: >"$OUT"
+for n in $CLIENTS; do
+  DISPLAY=$DPY ./tfwm &
+  tfwm=$!
+  DISPLAY=$DPY ./bench/tfwm_bench -n "$n" -o "$OUT" || exit 1
+  kill $tfwm
+  wait $tfwm 2>/dev/null
+  tfwm=
+done
+
+cat "$OUT"
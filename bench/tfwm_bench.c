@@ -0,0 +1,435 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <xcb/xcb.h>
+#include <xcb/xcb_keysyms.h>
+#include <xcb/xproto.h>
+#include <xcb/xtest.h>
+
+typedef struct {
+  xcb_connection_t *c;
+  xcb_screen_t *sc;
+  xcb_keycode_t kc_mod;
+  xcb_keycode_t kc_ws1;
+  xcb_keycode_t kc_ws2;
+  xcb_keycode_t kc_next;
+  uint32_t win_len;
+  xcb_window_t *win_list;
+  uint32_t configure;
+  uint32_t map;
+  xcb_window_t place_win;
+  int place_mapped;
+  uint32_t place;
+  uint32_t focus;
+  uint32_t focus_out;
+  uint32_t stats;
+  xcb_atom_t atom_stats;
+  xcb_atom_t atom_stats_request;
+  unsigned long long req;
+  unsigned long long rt;
+  FILE *out;
+} tfwm_bench_t;
+
+static const int TFWM_BENCH_TIMEOUT_MS = 5000;
+static const int TFWM_BENCH_REPEAT = 20;
+static const xcb_keysym_t TFWM_BENCH_KEY_MOD = 0xffeb; /* Super_L */
+static const xcb_keysym_t TFWM_BENCH_KEY_WS1 = 0x0031; /* 1 */
+static const xcb_keysym_t TFWM_BENCH_KEY_WS2 = 0x0032; /* 2 */
+static const xcb_keysym_t TFWM_BENCH_KEY_NEXT = 0x006c; /* l */
+
+static tfwm_bench_t bench;
+
+static uint64_t tfwm_bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static xcb_keycode_t tfwm_bench_keycode(xcb_key_symbols_t *k, xcb_keysym_t ks) {
+  xcb_keycode_t *kc = xcb_key_symbols_get_keycode(k, ks);
+  if (!kc) {
+    return 0;
+  }
+  xcb_keycode_t r = kc[0];
+  free(kc);
+  return r;
+}
+
+static int tfwm_bench_wm_ready(void) {
+  const char *name = "_NET_SUPPORTING_WM_CHECK";
+  xcb_intern_atom_reply_t *a = xcb_intern_atom_reply(
+      bench.c, xcb_intern_atom(bench.c, 1, strlen(name), name), NULL
+  );
+  if (!a) {
+    return 0;
+  }
+  if (XCB_ATOM_NONE == a->atom) {
+    free(a);
+    return 0;
+  }
+
+  xcb_get_property_reply_t *p = xcb_get_property_reply(
+      bench.c,
+      xcb_get_property(
+          bench.c, 0, bench.sc->root, a->atom, XCB_ATOM_WINDOW, 0, 1
+      ),
+      NULL
+  );
+  free(a);
+  int ok = p && (xcb_get_property_value_length(p) > 0);
+  free(p);
+  return ok;
+}
+
+static xcb_atom_t tfwm_bench_atom(const char *name) {
+  xcb_intern_atom_reply_t *a = xcb_intern_atom_reply(
+      bench.c, xcb_intern_atom(bench.c, 0, strlen(name), name), NULL
+  );
+  if (!a) {
+    return XCB_ATOM_NONE;
+  }
+  xcb_atom_t r = a->atom;
+  free(a);
+  return r;
+}
+
+static void tfwm_bench_count(xcb_generic_event_t *e) {
+  switch (e->response_type & ~0x80) {
+    case XCB_CONFIGURE_NOTIFY:
+      bench.configure++;
+      if (bench.place_mapped &&
+          (((xcb_configure_notify_event_t *)e)->window == bench.place_win)) {
+        bench.place++;
+      }
+      break;
+    case XCB_MAP_NOTIFY:
+      bench.map++;
+      if (((xcb_map_notify_event_t *)e)->window == bench.place_win) {
+        bench.place_mapped = 1;
+      }
+      break;
+    case XCB_FOCUS_IN:
+      if (((xcb_focus_in_event_t *)e)->detail != XCB_NOTIFY_DETAIL_POINTER) {
+        bench.focus++;
+      }
+      break;
+    case XCB_FOCUS_OUT:
+      if (((xcb_focus_out_event_t *)e)->detail != XCB_NOTIFY_DETAIL_POINTER) {
+        bench.focus_out++;
+      }
+      break;
+    case XCB_PROPERTY_NOTIFY:
+      if (((xcb_property_notify_event_t *)e)->atom == bench.atom_stats) {
+        bench.stats++;
+      }
+      break;
+  }
+}
+
+static int tfwm_bench_wait(uint32_t *counter, uint32_t target) {
+  uint64_t deadline = tfwm_bench_now() + TFWM_BENCH_TIMEOUT_MS * 1000;
+  xcb_flush(bench.c);
+
+  while (*counter < target) {
+    xcb_generic_event_t *e = xcb_poll_for_event(bench.c);
+    if (e) {
+      tfwm_bench_count(e);
+      free(e);
+      continue;
+    }
+    if (xcb_connection_has_error(bench.c)) {
+      return 0;
+    }
+
+    uint64_t now = tfwm_bench_now();
+    if (now >= deadline) {
+      return 0;
+    }
+    struct pollfd pfd = {xcb_get_file_descriptor(bench.c), POLLIN, 0};
+    poll(&pfd, 1, (int)((deadline - now) / 1000) + 1);
+  }
+
+  return 1;
+}
+
+static void tfwm_bench_drain(void) {
+  free(xcb_get_input_focus_reply(bench.c, xcb_get_input_focus(bench.c), NULL));
+  xcb_generic_event_t *e;
+  while ((e = xcb_poll_for_event(bench.c))) {
+    tfwm_bench_count(e);
+    free(e);
+  }
+}
+
+static unsigned long long tfwm_bench_stat(const char *buf, const char *key) {
+  size_t len = strlen(key);
+  for (const char *l = buf; l && *l; l = strchr(l, '\n')) {
+    if ('\n' == *l) {
+      l++;
+    }
+    if ((0 == strncmp(l, key, len)) && (' ' == l[len])) {
+      return strtoull(l + len + 1, NULL, 10);
+    }
+  }
+  return 0;
+}
+
+static int tfwm_bench_stats(void) {
+  xcb_change_property(
+      bench.c,
+      XCB_PROP_MODE_REPLACE,
+      bench.sc->root,
+      bench.atom_stats_request,
+      XCB_ATOM_CARDINAL,
+      32,
+      0,
+      NULL
+  );
+  if (!tfwm_bench_wait(&bench.stats, bench.stats + 1)) {
+    return 0;
+  }
+
+  xcb_get_property_reply_t *p = xcb_get_property_reply(
+      bench.c,
+      xcb_get_property(
+          bench.c, 0, bench.sc->root, bench.atom_stats, XCB_ATOM_STRING, 0, 16384
+      ),
+      NULL
+  );
+  if (!p) {
+    return 0;
+  }
+
+  int len = xcb_get_property_value_length(p);
+  char *buf = malloc(len + 1);
+  memcpy(buf, xcb_get_property_value(p), len);
+  buf[len] = '\0';
+  free(p);
+
+  bench.req = tfwm_bench_stat(buf, "flush.requests");
+  bench.rt = tfwm_bench_stat(buf, "roundtrip.total");
+  free(buf);
+  return 1;
+}
+
+static void tfwm_bench_key(xcb_keycode_t kc) {
+  xcb_window_t root = bench.sc->root;
+  xcb_test_fake_input(bench.c, XCB_KEY_PRESS, bench.kc_mod, 0, root, 0, 0, 0);
+  xcb_test_fake_input(bench.c, XCB_KEY_PRESS, kc, 0, root, 0, 0, 0);
+  xcb_test_fake_input(bench.c, XCB_KEY_RELEASE, kc, 0, root, 0, 0, 0);
+  xcb_test_fake_input(bench.c, XCB_KEY_RELEASE, bench.kc_mod, 0, root, 0, 0, 0);
+}
+
+static int tfwm_bench_cmp(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void tfwm_bench_report(
+    const char *op, uint64_t *samples, uint32_t n, uint32_t configure
+) {
+  unsigned long long req = bench.req;
+  unsigned long long rt = bench.rt;
+  int has_stats = tfwm_bench_stats();
+
+  if (0 == n) {
+    fprintf(
+        bench.out,
+        "{\"clients\":%u,\"op\":\"%s\",\"n\":0,\"error\":\"timeout\"}\n",
+        bench.win_len,
+        op
+    );
+    return;
+  }
+
+  uint64_t sum = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    sum += samples[i];
+  }
+  qsort(samples, n, sizeof(uint64_t), tfwm_bench_cmp);
+  fprintf(
+      bench.out,
+      "{\"clients\":%u,\"op\":\"%s\",\"n\":%u,\"mean_us\":%llu,"
+      "\"p50_us\":%llu,\"p99_us\":%llu,\"max_us\":%llu,"
+      "\"configure_notify_per_op\":%.2f",
+      bench.win_len,
+      op,
+      n,
+      (unsigned long long)(sum / n),
+      (unsigned long long)samples[n / 2],
+      (unsigned long long)samples[(n * 99) / 100],
+      (unsigned long long)samples[n - 1],
+      (double)configure / n
+  );
+  if (has_stats) {
+    fprintf(
+        bench.out,
+        ",\"requests_per_op\":%.2f,\"roundtrips_per_op\":%.2f",
+        (double)(bench.req - req - 1) / n,
+        (double)(bench.rt - rt) / n
+    );
+  }
+  fprintf(bench.out, "}\n");
+  fflush(bench.out);
+}
+
+static void tfwm_bench_map(void) {
+  uint64_t *s = calloc(bench.win_len, sizeof(uint64_t));
+  uint32_t n = 0;
+  uint32_t cfg = bench.configure;
+  uint32_t mask = XCB_CW_EVENT_MASK;
+  uint32_t vs[1] = {XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_FOCUS_CHANGE};
+
+  for (uint32_t i = 0; i < bench.win_len; i++) {
+    xcb_window_t w = xcb_generate_id(bench.c);
+    xcb_create_window(
+        bench.c,
+        XCB_COPY_FROM_PARENT,
+        w,
+        bench.sc->root,
+        0,
+        0,
+        100,
+        100,
+        0,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT,
+        bench.sc->root_visual,
+        mask,
+        vs
+    );
+    xcb_change_property(
+        bench.c,
+        XCB_PROP_MODE_REPLACE,
+        w,
+        XCB_ATOM_WM_CLASS,
+        XCB_ATOM_STRING,
+        8,
+        12,
+        "bench\0bench\0"
+    );
+    bench.win_list[i] = w;
+
+    bench.place_win = w;
+    bench.place_mapped = 0;
+    uint64_t t0 = tfwm_bench_now();
+    xcb_map_window(bench.c, w);
+    if (!tfwm_bench_wait(&bench.place, bench.place + 1)) {
+      break;
+    }
+    s[n++] = tfwm_bench_now() - t0;
+  }
+  bench.place_win = XCB_WINDOW_NONE;
+
+  tfwm_bench_drain();
+  tfwm_bench_report("map_configure", s, n, bench.configure - cfg);
+  free(s);
+}
+
+static void tfwm_bench_workspace(void) {
+  uint64_t s[TFWM_BENCH_REPEAT];
+  uint32_t n = 0;
+  uint32_t cfg = bench.configure;
+
+  for (int i = 0; i < TFWM_BENCH_REPEAT; i++) {
+    uint64_t t0 = tfwm_bench_now();
+    tfwm_bench_key(bench.kc_ws2);
+    if (!tfwm_bench_wait(&bench.focus_out, bench.focus_out + 1)) {
+      break;
+    }
+    tfwm_bench_key(bench.kc_ws1);
+    if (!tfwm_bench_wait(&bench.focus, bench.focus + 1)) {
+      break;
+    }
+    s[n++] = (tfwm_bench_now() - t0) / 2;
+  }
+
+  tfwm_bench_drain();
+  tfwm_bench_report("workspace_switch", s, n, bench.configure - cfg);
+}
+
+static void tfwm_bench_focus(void) {
+  uint64_t s[TFWM_BENCH_REPEAT];
+  uint32_t n = 0;
+  uint32_t cfg = bench.configure;
+
+  for (int i = 0; i < TFWM_BENCH_REPEAT; i++) {
+    uint64_t t0 = tfwm_bench_now();
+    tfwm_bench_key(bench.kc_next);
+    if (!tfwm_bench_wait(&bench.focus, bench.focus + 1)) {
+      break;
+    }
+    s[n++] = tfwm_bench_now() - t0;
+  }
+
+  tfwm_bench_drain();
+  tfwm_bench_report("focus_cycle", s, n, bench.configure - cfg);
+}
+
+int main(int argc, char *argv[]) {
+  bench.win_len = 10;
+  bench.out = stdout;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:o:")) != -1) {
+    if ('n' == opt) {
+      bench.win_len = atoi(optarg);
+    } else if ('o' == opt) {
+      bench.out = fopen(optarg, "a");
+      if (!bench.out) {
+        printf("ERROR: can not open %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+    } else {
+      printf("usage: tfwm_bench [-n clients] [-o file]\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  bench.c = xcb_connect(NULL, NULL);
+  if (xcb_connection_has_error(bench.c)) {
+    printf("xcb_connection_has_error\n");
+    return EXIT_FAILURE;
+  }
+  bench.sc = xcb_setup_roots_iterator(xcb_get_setup(bench.c)).data;
+
+  uint64_t deadline = tfwm_bench_now() + TFWM_BENCH_TIMEOUT_MS * 1000;
+  while (!tfwm_bench_wm_ready()) {
+    if (tfwm_bench_now() >= deadline) {
+      printf("ERROR: window manager is not running\n");
+      return EXIT_FAILURE;
+    }
+    struct timespec ts = {0, 10000000};
+    nanosleep(&ts, NULL);
+  }
+
+  xcb_key_symbols_t *k = xcb_key_symbols_alloc(bench.c);
+  bench.kc_mod = tfwm_bench_keycode(k, TFWM_BENCH_KEY_MOD);
+  bench.kc_ws1 = tfwm_bench_keycode(k, TFWM_BENCH_KEY_WS1);
+  bench.kc_ws2 = tfwm_bench_keycode(k, TFWM_BENCH_KEY_WS2);
+  bench.kc_next = tfwm_bench_keycode(k, TFWM_BENCH_KEY_NEXT);
+  xcb_key_symbols_free(k);
+
+  bench.atom_stats = tfwm_bench_atom("_TFWM_STATS");
+  bench.atom_stats_request = tfwm_bench_atom("_TFWM_STATS_REQUEST");
+  uint32_t rvs[1] = {XCB_EVENT_MASK_PROPERTY_CHANGE};
+  xcb_change_window_attributes(bench.c, bench.sc->root, XCB_CW_EVENT_MASK, rvs);
+  tfwm_bench_stats();
+
+  bench.win_list = calloc(bench.win_len, sizeof(xcb_window_t));
+  tfwm_bench_map();
+  tfwm_bench_workspace();
+  tfwm_bench_focus();
+
+  free(bench.win_list);
+  xcb_disconnect(bench.c);
+  if (bench.out != stdout) {
+    fclose(bench.out);
+  }
+  return EXIT_SUCCESS;
+}
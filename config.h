@@ -29,6 +29,7 @@ static const uint32_t TFWM_MIN_WINDOW_HEIGHT = 40;
 static const uint32_t TFWM_BORDER_WIDTH = 1;
 static const uint32_t TFWM_BORDER_ACTIVE = WHITE;
 static const uint32_t TFWM_BORDER_INACTIVE = GRAY;
+static const uint32_t TFWM_FRAME_BACKGROUND = BLACK;
 
 static const double TFWM_TILE_MASTER = 50.0;
 
@@ -41,6 +42,8 @@ static const uint32_t TFWM_BAR_FOREGROUND = WHITE;
 static const uint32_t TFWM_BAR_BACKGROUND = BLACK;
 static const uint32_t TFWM_BAR_FOREGROUND_ACTIVE = BLACK;
 static const uint32_t TFWM_BAR_BACKGROUND_ACTIVE = WHITE;
+static const char *TFWM_BAR_CLOCK = "%a %d %b %H:%M";
+static const uint32_t TFWM_BAR_CLOCK_INTERVAL = 1000;
 
 static const char *cfg_workspace[] = {"1", "2", "3", "4", "5", "6", "7", "8", "9"};
 static const tfwm_layout_t cfg_layout[] = {
@@ -61,7 +64,8 @@ static const char *cmd_ws8[] = {"8", NULL};
 static const char *cmd_ws9[] = {"9", NULL};
 
 static const tfwm_keybind_t cfg_keybinds[] = {
-    {MOD_KEY | MOD_SHIFT, 0x0071, tfwm_exit, NULL}, /* q */
+    {MOD_KEY | MOD_SHIFT, 0x0071, tfwm_exit, NULL},    /* q */
+    {MOD_KEY | MOD_SHIFT, 0x0072, tfwm_restart, NULL}, /* r */
 
     {MOD_KEY, 0x0071, tfwm_window_kill, NULL},      /* q */
     {MOD_KEY, 0xff0d, tfwm_window_spawn, cmd_term}, /* Return */
@@ -101,6 +105,12 @@ static const tfwm_keybind_t cfg_keybinds[] = {
     {MOD_KEY, 0x0077, tfwm_workspace_use_window, NULL},   /* w */
 };
 
+static const char *TFWM_CONFIG_FILE = ".config/tfwm/config";
 static const char *TFWM_LOG_FILE = ".local/share/tfwm.0.log";
+static const int TFWM_LOG_VERBOSITY = TFWM_LOG_INFO;
+static const char *TFWM_STATS_FILE = ".local/share/tfwm.stats";
+static const char *TFWM_TRACE_FILE = ".local/share/tfwm.trace.json";
+static const char *TFWM_JOURNAL_FILE = ".local/share/tfwm-%s.journal";
+static const char *TFWM_SOCKET_FILE = "tfwm-%s.sock";
 
 #endif  // !CONFIG_H
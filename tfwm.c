@@ -1,123 +1,245 @@
 #include "tfwm.h"
 
 #include "config.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/file.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
+#include <xcb/randr.h>
 #include <xcb/xcb.h>
 #include <xcb/xcb_cursor.h>
 #include <xcb/xcb_keysyms.h>
+#include <xcb/xcbext.h>
 #include <xcb/xproto.h>
 
+extern char **environ;
+
 static tfwm_xcb_t core;
 
-static void tfwm_util_log(char *log, int exit) {
+static void tfwm_log_init(void) {
+  core.log.level = TFWM_LOG_VERBOSITY;
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  core.log.epoch =
+      (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - tfwm_stats_now();
+
   char *home = getenv("HOME");
   if (!home) {
     return;
   }
-  char *path = malloc(strlen(home) + strlen(TFWM_LOG_FILE) + 2);
+  char path[strlen(home) + strlen(TFWM_LOG_FILE) + 2];
   sprintf(path, "%s/%s", home, TFWM_LOG_FILE);
-
-  FILE *file;
-  if (access(path, F_OK) != 0) {
-    file = fopen(path, "w");
-  } else {
-    file = fopen(path, "a");
-  }
-  if (!file) {
+  core.log.fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (core.log.fd < 0) {
     printf("ERROR: can not open log file\n");
-    return;
   }
-  free(path);
+}
 
-  time_t t = time(NULL);
-  struct tm *now = localtime(&t);
-  char tstmp[20];
-  strftime(tstmp, 20, "%Y-%m-%d %H:%M:%S", now);
+static void tfwm_log_write(int level, int sys, const char *fmt, ...) {
+  if ((core.log.head - core.log.tail) >= TFWM_LOG_RING) {
+    core.log.lost++;
+    return;
+  }
 
-  fprintf(file, "[%s] %s\n", tstmp, log);
-  fclose(file);
-  core.exit = exit;
+  tfwm_log_record_t *r = &core.log.ring[core.log.head % TFWM_LOG_RING];
+  r->t = tfwm_stats_now();
+  r->level = level;
+  r->sys = sys;
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(r->msg, sizeof(r->msg), fmt, ap);
+  va_end(ap);
+  core.log.head++;
+}
+
+static void tfwm_log_drain(void) {
+  char buf[TFWM_LOG_BATCH * (TFWM_LOG_MSG + 64)];
+  while ((core.log.tail != core.log.head) || core.log.lost) {
+    size_t len = 0;
+    if (core.log.lost) {
+      len += sprintf(buf, "%u log records lost\n", core.log.lost);
+      core.log.lost = 0;
+    }
+    for (int n = 0; (n < TFWM_LOG_BATCH) && (core.log.tail != core.log.head); n++) {
+      tfwm_log_record_t *r = &core.log.ring[core.log.tail % TFWM_LOG_RING];
+      int64_t us = (int64_t)r->t + core.log.epoch;
+      time_t sec = us / 1000000;
+      struct tm tm;
+      localtime_r(&sec, &tm);
+      len += strftime(buf + len, 32, "[%Y-%m-%d %H:%M:%S", &tm);
+      len += sprintf(
+          buf + len,
+          ".%06d] %s %s: %s\n",
+          (int)(us % 1000000),
+          TFWM_LOG_NAME[r->level],
+          TFWM_SYS_NAME[r->sys],
+          r->msg
+      );
+      core.log.tail++;
+    }
+    if ((core.log.fd >= 0) && (write(core.log.fd, buf, len) < 0)) {
+      break;
+    }
+  }
+  core.log.tail = core.log.head;
 }
 
-static xcb_keycode_t *tfwm_util_keycodes(xcb_keysym_t keysym) {
-  xcb_key_symbols_t *k = xcb_key_symbols_alloc(core.c);
-  xcb_keycode_t *kc = (!(k) ? NULL : xcb_key_symbols_get_keycode(k, keysym));
-  xcb_key_symbols_free(k);
-  return kc;
+static void tfwm_log_cleanup(void) {
+  tfwm_log_drain();
+  if (core.log.fd >= 0) {
+    close(core.log.fd);
+  }
+  core.log.fd = -1;
 }
 
-static xcb_keysym_t tfwm_util_keysym(xcb_keycode_t keycode) {
-  xcb_key_symbols_t *k = xcb_key_symbols_alloc(core.c);
-  xcb_keysym_t ks = (!(k) ? 0 : xcb_key_symbols_get_keysym(k, keycode, 0));
-  xcb_key_symbols_free(k);
-  return ks;
-}
+static void tfwm_util_cursors(void) {
+  const char *names[TFWM_CSR_LEN] = {
+      [TFWM_CSR_DEFAULT] = TFWM_CURSOR_DEFAULT,
+      [TFWM_CSR_MOVE] = TFWM_CURSOR_MOVE,
+      [TFWM_CSR_RESIZE] = TFWM_CURSOR_RESIZE,
+  };
 
-static xcb_cursor_t tfwm_util_cursor(char *name) {
+  uint64_t t = tfwm_stats_roundtrip(TFWM_STAT_RT_CURSOR);
   xcb_cursor_context_t *ctx;
   if (xcb_cursor_context_new(core.c, core.sc, &ctx) < 0) {
-    return XCB_CURSOR_NONE;
+    return;
+  }
+  for (int i = 0; i < TFWM_CSR_LEN; i++) {
+    core.cursor[i] = xcb_cursor_load_cursor(ctx, names[i]);
   }
-  xcb_cursor_t c = xcb_cursor_load_cursor(ctx, name);
   xcb_cursor_context_free(ctx);
-  return c;
+  tfwm_trace_end(TFWM_TRACE_WAIT, TFWM_STAT_RT_CURSOR, t, 0);
 }
 
-static xcb_atom_t tfwm_util_atom(char *name) {
-  xcb_intern_atom_reply_t *r = xcb_intern_atom_reply(
-      core.c, xcb_intern_atom(core.c, 0, strlen(name), name), NULL
-  );
-  if (!r) {
-    return 0;
+static void tfwm_util_atoms(xcb_intern_atom_cookie_t *ck) {
+  uint64_t t = tfwm_stats_roundtrip(TFWM_STAT_RT_ATOM);
+  for (int i = 0; i < TFWM_ATOM_LEN; i++) {
+    xcb_intern_atom_reply_t *r = xcb_intern_atom_reply(core.c, ck[i], NULL);
+    core.atom[i] = r ? r->atom : XCB_ATOM_NONE;
+    free(r);
   }
-  xcb_atom_t a = r->atom;
-  free(r);
-  return a;
+  tfwm_trace_end(TFWM_TRACE_WAIT, TFWM_STAT_RT_ATOM, t, 0);
 }
 
-static char *tfwm_util_window_class(xcb_window_t window) {
-  xcb_intern_atom_reply_t *r = xcb_intern_atom_reply(
-      core.c, xcb_intern_atom(core.c, 0, strlen("WM_CLASS"), "WM_CLASS"), NULL
-  );
-  if (!r) {
+static char *tfwm_util_prop_string(xcb_get_property_reply_t *p, int skip) {
+  if (!p) {
     return NULL;
   }
-  xcb_atom_t a = r->atom;
-  free(r);
 
-  xcb_get_property_reply_t *p = xcb_get_property_reply(
-      core.c, xcb_get_property(core.c, 0, window, a, XCB_ATOM_STRING, 0, 250), NULL
-  );
-  if (!p) {
-    return NULL;
+  int n = xcb_get_property_value_length(p);
+  char *v = (char *)xcb_get_property_value(p);
+  char *c = v;
+  for (int i = 0; i < skip; i++) {
+    c = memchr(c, '\0', n - (c - v));
+    if (!c || (++c - v) >= n) {
+      return NULL;
+    }
   }
-  if (xcb_get_property_value_length(p) == 0) {
-    free(p);
+  if ((c - v) >= n) {
     return NULL;
   }
 
-  char *class = (char *)xcb_get_property_value(p);
-  free(p);
-  class = class + strlen(class) + 1;
+  size_t len = n - (c - v);
+  char *end = memchr(c, '\0', len);
+  if (end) {
+    len = end - c;
+  }
+  char *s = malloc(len + 1);
+  memcpy(s, c, len);
+  s[len] = '\0';
+
+  return s;
+}
+
+static void tfwm_util_font_metrics(xcb_query_font_cookie_t ck) {
+  for (int i = 0; i < ARRAY_LENGTH(core.font_adv); i++) {
+    core.font_adv[i] = -1;
+  }
+
+  uint64_t t = tfwm_stats_roundtrip(TFWM_STAT_RT_FONT);
+  xcb_query_font_reply_t *r = xcb_query_font_reply(core.c, ck, NULL);
+  tfwm_trace_end(TFWM_TRACE_WAIT, TFWM_STAT_RT_FONT, t, 0);
+  if (!r) {
+    return;
+  }
+  if (r->min_byte1 != 0) {
+    free(r);
+    return;
+  }
+
+  xcb_charinfo_t *ci = xcb_query_font_char_infos(r);
+  int n = xcb_query_font_char_infos_length(r);
+  for (int i = r->min_char_or_byte2; (i <= r->max_char_or_byte2) && (i < 256); i++) {
+    if (0 == n) {
+      core.font_adv[i] = r->max_bounds.character_width;
+      continue;
+    }
+    if ((i - r->min_char_or_byte2) >= n) {
+      break;
+    }
+    xcb_charinfo_t *g = &ci[i - r->min_char_or_byte2];
+    if (r->all_chars_exist || g->character_width || g->ascent || g->descent) {
+      core.font_adv[i] = g->character_width;
+    }
+  }
 
-  return class;
+  uint16_t d = r->default_char;
+  if ((d < 256) && (core.font_adv[d] >= 0)) {
+    for (int i = 0; i < ARRAY_LENGTH(core.font_adv); i++) {
+      if (core.font_adv[i] < 0) {
+        core.font_adv[i] = core.font_adv[d];
+      }
+    }
+  }
+  free(r);
 }
 
 static int tfwm_util_text_width(char *text) {
+  int w = 0;
+  for (unsigned char *p = (unsigned char *)text; *p; p++) {
+    if (core.font_adv[*p] < 0) {
+      return tfwm_util_text_extents(text);
+    }
+    w += core.font_adv[*p];
+  }
+
+  return w;
+}
+
+static int tfwm_util_text_extents(char *text) {
   size_t n = strlen(text);
-  xcb_char2b_t b[n * sizeof(xcb_char2b_t)];
-  for (int i = 0; i < n; i++) {
+  if (0 == n) {
+    return 0;
+  }
+
+  xcb_char2b_t b[n];
+  for (size_t i = 0; i < n; i++) {
     b[i].byte1 = 0;
     b[i].byte2 = text[i];
   }
 
+  uint64_t t = tfwm_stats_roundtrip(TFWM_STAT_RT_TEXT_EXTENTS);
   xcb_query_text_extents_reply_t *r = xcb_query_text_extents_reply(
       core.c, xcb_query_text_extents(core.c, core.font, n, b), NULL
   );
+  tfwm_trace_end(TFWM_TRACE_WAIT, TFWM_STAT_RT_TEXT_EXTENTS, t, 0);
   if (!r) {
     return 0;
   }
@@ -128,21 +250,51 @@ static int tfwm_util_text_width(char *text) {
   return w;
 }
 
+static void tfwm_util_display(char *buf, size_t n) {
+  char *d = getenv("DISPLAY");
+  snprintf(buf, n, "%s", d ? d : ":0");
+  for (char *c = buf; *c; c++) {
+    if ('/' == *c) {
+      *c = '_';
+    }
+  }
+}
+
 static void tfwm_util_cleanup(void) {
   if (core.ws_list) {
-    for (uint32_t i = 0; i < core.ws_len; i++) {
-      if (core.ws_list[i].win_list) {
-        for (uint32_t j = 0; j < core.ws_list[i].win_cap; j++) {
-          if (core.ws_list[i].win_list[j].class) {
-            free(core.ws_list[i].win_list[j].class);
-          }
-        }
-        free(core.ws_list[i].win_list);
+    free(core.ws_list);
+  }
+  if (core.arena.list) {
+    for (uint32_t i = 0; i < core.arena.len; i++) {
+      if (core.arena.list[i].win) {
+        free(core.arena.list[i].class);
       }
     }
-    free(core.ws_list);
+    free(core.arena.list);
   }
 
+  if (core.index.list) {
+    free(core.index.list);
+  }
+  if (core.scratch.list) {
+    free(core.scratch.list);
+  }
+  if (core.launch.list) {
+    free(core.launch.list);
+  }
+  if (core.pending.list) {
+    for (uint32_t i = 0; i < core.pending.len; i++) {
+      for (int j = 0; j < TFWM_PROP_LEN; j++) {
+        free(core.pending.list[i].r[j]);
+      }
+      free(core.pending.list[i].attr);
+      free(core.pending.list[i].geom);
+    }
+    free(core.pending.list);
+  }
+  if (core.kbd.syms) {
+    xcb_key_symbols_free(core.kbd.syms);
+  }
   if (core.font) {
     xcb_close_font(core.c, core.font);
   }
@@ -152,686 +304,3005 @@ static void tfwm_util_cleanup(void) {
   if (core.gc_inactive) {
     xcb_free_gc(core.c, core.gc_inactive);
   }
+  if (core.gc_background) {
+    xcb_free_gc(core.c, core.gc_background);
+  }
+  for (int i = 0; i < TFWM_CSR_LEN; i++) {
+    if (core.cursor[i]) {
+      xcb_free_cursor(core.c, core.cursor[i]);
+    }
+  }
+  if (core.out_list) {
+    for (uint32_t i = 0; i < core.out_len; i++) {
+      tfwm_output_bar_free(&core.out_list[i]);
+    }
+    free(core.out_list);
+  }
 }
 
-void tfwm_exit(char **cmd) {
-  if (core.c) {
-    tfwm_util_cleanup();
-    xcb_disconnect(core.c);
-  }
+static uint64_t tfwm_stats_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
-void tfwm_window_spawn(char **cmd) {
-  if (fork() == 0) {
-    setsid();
-    if (fork() != 0) {
-      _exit(0);
-    }
-    execvp((char *)cmd[0], (char **)cmd);
-    _exit(0);
-  }
-  wait(NULL);
+static uint64_t tfwm_stats_roundtrip(int site) {
+  core.stats.rt[site]++;
+  return tfwm_trace_begin();
 }
 
-void tfwm_window_kill(char **cmd) {
-  if (0 == core.win) {
-    return;
-  }
-  if ((core.win) == core.sc->root) {
-    return;
+static void tfwm_stats_latency(uint32_t *hist, uint64_t us) {
+  int b = 0;
+  while ((us > 1) && (b < TFWM_STATS_BUCKETS - 1)) {
+    us >>= 1;
+    b++;
   }
+  hist[b]++;
+}
 
-  xcb_window_t tgt = core.win;
-  tfwm_workspace_window_pop(core.cur_win);
-  tfwm_workspace_t *ws = &core.ws_list[core.cur_ws];
-  if (ws->win_len == 0) {
-    tfwm_window_focus(core.sc->root);
-  } else if ((core.cur_win + 1) >= ws->win_len) {
-    tfwm_window_focus(ws->win_list[ws->win_len - 1].win);
-  } else if ((core.cur_win + 1) < ws->win_len) {
-    tfwm_window_focus(ws->win_list[core.cur_win].win);
-  }
-  if (TFWM_LAYOUT_TILING == ws->layout) {
-    tfwm_layout_apply_tiling(core.cur_ws);
+static void tfwm_stats_flush(void) {
+  core.stats.flush++;
+  if (core.stats.req_on) {
+    unsigned int seq = xcb_no_operation(core.c).sequence;
+    uint32_t n = core.stats.seq ? seq - core.stats.seq - 1 : 0;
+    core.stats.seq = seq;
+    core.stats.req += n;
+    if (n > core.stats.req_max) {
+      core.stats.req_max = n;
+    }
   }
   xcb_flush(core.c);
-  xcb_kill_client(core.c, tgt);
 }
 
-void tfwm_window_next(char **cmd) {
-  tfwm_workspace_t *ws = &core.ws_list[core.cur_ws];
-  uint32_t wid;
-  uint8_t ok;
-  for (uint32_t i = 0; i < ws->win_len; i++) {
-    if (ws->win_list[i].win == core.win) {
-      wid = i;
-      ok = 1;
-      break;
-    }
-  }
-  if (0 == ok) {
-    return;
+static char *tfwm_stats_snapshot(void) {
+  char *buf = NULL;
+  size_t len = 0;
+  FILE *f = open_memstream(&buf, &len);
+  if (!f) {
+    return NULL;
   }
 
-  if ((wid + 1) == ws->win_len) {
-    tfwm_window_focus(ws->win_list[0].win);
-  } else {
-    tfwm_window_focus(ws->win_list[wid + 1].win);
+  unsigned long long rt = 0;
+  for (int i = 0; i < TFWM_STAT_RT_LEN; i++) {
+    fprintf(f, "roundtrip.%s %llu\n", TFWM_STAT_RT_NAME[i], core.stats.rt[i]);
+    rt += core.stats.rt[i];
   }
-}
+  fprintf(f, "roundtrip.total %llu\n", rt);
+  fprintf(f, "flush.count %llu\n", core.stats.flush);
+  fprintf(f, "flush.requests %llu\n", core.stats.req);
+  fprintf(f, "flush.requests_max %u\n", core.stats.req_max);
 
-void tfwm_window_prev(char **cmd) {
-  tfwm_workspace_t *ws = &core.ws_list[core.cur_ws];
-  uint32_t wid;
-  uint8_t ok;
-  for (uint32_t i = 0; i < ws->win_len; i++) {
-    if (ws->win_list[i].win == core.win) {
-      wid = i;
-      ok = 1;
-      break;
+  for (int i = 0; i < 256; i++) {
+    if (0 == core.stats.evt[i]) {
+      continue;
+    }
+    if (TFWM_EVENT_NAME[i]) {
+      fprintf(f, "event.%s %llu\n", TFWM_EVENT_NAME[i], core.stats.evt[i]);
+    } else {
+      fprintf(f, "event.%d %llu\n", i, core.stats.evt[i]);
     }
   }
-  if (0 == ok) {
-    return;
+
+  for (int i = 0; i < 256; i++) {
+    if (!event_handlers[i] || (0 == core.stats.evt[i])) {
+      continue;
+    }
+    fprintf(f, "latency_us_log2.%s", TFWM_EVENT_NAME[i]);
+    for (int j = 0; j < TFWM_STATS_BUCKETS; j++) {
+      fprintf(f, " %u", core.stats.hist[i][j]);
+    }
+    fprintf(f, "\n");
   }
 
-  if (0 == wid) {
-    tfwm_window_focus(ws->win_list[ws->win_len - 1].win);
-  } else {
-    tfwm_window_focus(ws->win_list[wid - 1].win);
+  fprintf(f, "launch.count %llu\n", core.stats.launch);
+  fprintf(f, "latency_us_log2.launch");
+  for (int j = 0; j < TFWM_STATS_BUCKETS; j++) {
+    fprintf(f, " %u", core.stats.launch_hist[j]);
   }
+  fprintf(f, "\n");
+
+  fclose(f);
+  return buf;
 }
 
-void tfwm_window_swap_last(char **cmd) {
-  if (core.ws_list[core.cur_ws].win_len < 2) {
+static void tfwm_stats_dump(void) {
+  core.stats.dump = 0;
+  core.stats.req_on = 1;
+  char *snap = tfwm_stats_snapshot();
+  if (!snap) {
     return;
   }
 
-  tfwm_workspace_t *ws = &core.ws_list[core.cur_ws];
-  uint32_t wid;
-  uint8_t ok;
-  for (uint32_t i = 0; i < ws->win_len; i++) {
-    if (ws->win_list[i].win == core.win) {
-      wid = i;
-      ok = 1;
-      break;
+  xcb_change_property(
+      core.c,
+      XCB_PROP_MODE_REPLACE,
+      core.sc->root,
+      core.atom[TFWM_ATOM_TFWM_STATS],
+      XCB_ATOM_STRING,
+      8,
+      strlen(snap),
+      snap
+  );
+
+  char *home = getenv("HOME");
+  if (home) {
+    char path[strlen(home) + strlen(TFWM_STATS_FILE) + 2];
+    sprintf(path, "%s/%s", home, TFWM_STATS_FILE);
+    FILE *file = fopen(path, "w");
+    if (file) {
+      fputs(snap, file);
+      fclose(file);
     }
   }
-  if (0 == ok) {
+  free(snap);
+}
+
+static uint64_t tfwm_trace_begin(void) {
+  return core.trace.list ? tfwm_stats_now() : 0;
+}
+
+static void tfwm_trace_end(int kind, uint32_t id, uint64_t t, uint32_t win) {
+  if (!core.trace.list || (0 == t)) {
     return;
   }
-  uint32_t last = ws->win_len - 1;
-  if ((wid) == last) {
-    return;
+
+  tfwm_trace_span_t *s = &core.trace.list[core.trace.head++ % TFWM_TRACE_SPANS];
+  s->ts = t;
+  s->dur = tfwm_stats_now() - t;
+  s->win = win;
+  s->id = id;
+  s->kind = kind;
+}
+
+static uint32_t tfwm_trace_window(xcb_generic_event_t *event) {
+  uint8_t e = event->response_type & ~0x80;
+  if ((e >= XCB_KEY_PRESS) && (e <= XCB_LEAVE_NOTIFY)) {
+    xcb_key_press_event_t *k = (xcb_key_press_event_t *)event;
+    return k->child ? k->child : k->event;
   }
-  if (core.win == ws->win_list[last].win) {
-    return;
+  switch (e) {
+  case XCB_FOCUS_IN:
+  case XCB_FOCUS_OUT:
+    return ((xcb_focus_in_event_t *)event)->event;
+  case XCB_EXPOSE:
+    return ((xcb_expose_event_t *)event)->window;
+  case XCB_DESTROY_NOTIFY:
+    return ((xcb_destroy_notify_event_t *)event)->window;
+  case XCB_UNMAP_NOTIFY:
+    return ((xcb_unmap_notify_event_t *)event)->window;
+  case XCB_MAP_REQUEST:
+    return ((xcb_map_request_event_t *)event)->window;
+  case XCB_PROPERTY_NOTIFY:
+    return ((xcb_property_notify_event_t *)event)->window;
   }
+  return 0;
+}
 
-  ws->win_list[last].win = core.win;
-  ws->win_list[wid].win = ws->win_list[last].win;
-  if (TFWM_LAYOUT_TILING == ws->layout) {
-    tfwm_layout_apply_tiling(core.cur_ws);
+static const char *tfwm_trace_name(tfwm_trace_span_t *s) {
+  if ((TFWM_TRACE_EVENT == s->kind) && TFWM_EVENT_NAME[s->id & 0xff]) {
+    return TFWM_EVENT_NAME[s->id & 0xff];
   }
-  tfwm_window_focus(core.win);
+  if ((TFWM_TRACE_WAIT == s->kind) && (s->id < TFWM_STAT_RT_LEN)) {
+    return TFWM_STAT_RT_NAME[s->id];
+  }
+  if (TFWM_TRACE_LAYOUT == s->kind) {
+    return "tfwm_layout_update";
+  }
+  if (TFWM_TRACE_BAR == s->kind) {
+    return "tfwm_bar";
+  }
+  return TFWM_TRACE_CATEGORY[s->kind];
 }
 
-void tfwm_window_fullscreen(char **cmd) {
-  if (0 == core.win) {
+static void tfwm_trace_write(void) {
+  char *home = getenv("HOME");
+  if (!home) {
     return;
   }
-  if ((core.win) == core.sc->root) {
+  char path[strlen(home) + strlen(TFWM_TRACE_FILE) + 2];
+  sprintf(path, "%s/%s", home, TFWM_TRACE_FILE);
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    TFWM_LOG(TFWM_LOG_WARN, TFWM_SYS_CORE, "can not write %s", path);
     return;
   }
 
-  int x = 0 - TFWM_BORDER_WIDTH;
-  int y = 0 - TFWM_BORDER_WIDTH;
-  int w = core.sc->width_in_pixels;
-  int h = core.sc->height_in_pixels;
-  tfwm_window_t *win = &core.ws_list[core.cur_ws].win_list[core.cur_win];
+  uint64_t head = core.trace.head;
+  uint32_t n = (head > TFWM_TRACE_SPANS) ? TFWM_TRACE_SPANS : head;
+  uint64_t i = head - n;
+  int pid = getpid();
+  fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  for (const char *sep = "\n"; i < head; i++, sep = ",\n") {
+    tfwm_trace_span_t *s = &core.trace.list[i % TFWM_TRACE_SPANS];
+    fprintf(
+        f,
+        "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%llu,"
+        "\"dur\":%u,\"pid\":%d,\"tid\":%d,\"args\":{\"window\":\"0x%x\","
+        "\"id\":%u}}",
+        sep,
+        tfwm_trace_name(s),
+        TFWM_TRACE_CATEGORY[s->kind],
+        (unsigned long long)s->ts,
+        s->dur,
+        pid,
+        pid,
+        s->win,
+        s->id
+    );
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+  TFWM_LOG(
+      TFWM_LOG_INFO,
+      TFWM_SYS_CORE,
+      "wrote %u spans to %s, %llu dropped",
+      n,
+      path,
+      (unsigned long long)(head - n)
+  );
+}
 
-  if (1 == win->is_fullscreen) {
-    x = win->x;
-    y = win->y;
-    w = win->w;
-    h = win->h;
+static tfwm_window_t *tfwm_arena_get(tfwm_handle_t handle) {
+  uint32_t slot = (handle & TFWM_HANDLE_SLOT_MASK) - 1;
+  if ((0 == handle) || (slot >= core.arena.len)) {
+    return NULL;
   }
 
-  tfwm_window_move(core.win, x, y);
-  tfwm_window_resize(core.win, w, h);
-  win->is_fullscreen ^= 1;
+  tfwm_window_t *w = &core.arena.list[slot];
+  if ((w->gen << TFWM_HANDLE_SLOT_BITS) != (handle & ~TFWM_HANDLE_SLOT_MASK)) {
+    return NULL;
+  }
+  return w;
 }
 
-void tfwm_window_to_workspace(char **cmd) {
-  uint32_t wsid;
-  uint8_t ok;
-  for (uint32_t i = 0; i < core.ws_len; i++) {
-    if (strcmp((char *)cmd[0], core.ws_list[i].name) == 0) {
-      if (i == core.cur_ws) {
-        return;
+static tfwm_handle_t tfwm_arena_alloc(void) {
+  uint32_t slot;
+  if (core.arena.free) {
+    slot = (core.arena.free & TFWM_HANDLE_SLOT_MASK) - 1;
+    core.arena.free = core.arena.list[slot].next;
+  } else {
+    if (core.arena.len == core.arena.cap) {
+      uint32_t cap = core.arena.cap ? core.arena.cap * 2 : TFWM_ARENA_ALLOC;
+      if (cap > (1u << TFWM_HANDLE_SLOT_BITS) - 1) {
+        return 0;
       }
-      wsid = i;
-      ok = 1;
-      break;
+      tfwm_window_t *tmp = realloc(core.arena.list, cap * sizeof(tfwm_window_t));
+      if (!tmp) {
+        return 0;
+      }
+      core.arena.list = tmp;
+      core.arena.cap = cap;
     }
+    slot = core.arena.len++;
+    core.arena.list[slot].gen = 0;
   }
-  if (0 == ok) {
-    return;
-  }
-  if (0 == core.cur_win) {
-    return;
-  }
-  if ((core.win) == core.sc->root) {
+
+  uint32_t gen = core.arena.list[slot].gen;
+  core.arena.list[slot] = (tfwm_window_t){0};
+  core.arena.list[slot].gen = gen;
+  return (gen << TFWM_HANDLE_SLOT_BITS) | (slot + 1);
+}
+
+static void tfwm_arena_free(tfwm_handle_t handle) {
+  tfwm_window_t *w = tfwm_arena_get(handle);
+  if (!w) {
     return;
   }
 
-  tfwm_workspace_window_append(
-      wsid, core.ws_list[core.cur_ws].win_list[core.cur_win]
-  );
-  tfwm_workspace_window_pop(core.cur_win);
+  uint32_t gen = (w->gen + 1) & (~TFWM_HANDLE_SLOT_MASK >> TFWM_HANDLE_SLOT_BITS);
+  *w = (tfwm_window_t){0};
+  w->gen = gen;
+  w->next = core.arena.free;
+  core.arena.free = handle & TFWM_HANDLE_SLOT_MASK;
+}
 
-  core.prv_ws = core.cur_ws;
-  core.cur_ws = wsid;
-  if (core.ws_list[core.prv_ws].layout != core.ws_list[core.cur_ws].layout) {
-    tfwm_layout_update(core.cur_ws);
-  }
-  tfwm_workspace_window_unmap(core.prv_ws);
-  tfwm_workspace_window_map(core.cur_ws);
+static uint32_t tfwm_index_hash(xcb_window_t window) {
+  uint32_t h = window * 0x9e3779b1u;
+  return (h ^ (h >> 15)) & (core.index.cap - 1);
 }
 
-void tfwm_workspace_switch(char **cmd) {
-  uint32_t wsid;
-  uint8_t ok;
-  for (uint32_t i = 0; i < core.ws_len; i++) {
-    if (strcmp((char *)cmd[0], core.ws_list[i].name) == 0) {
-      if (i == core.cur_ws) {
-        return;
-      }
-      wsid = i;
-      ok = 1;
-      break;
+static tfwm_index_entry_t *tfwm_index_find(xcb_window_t window) {
+  if ((0 == window) || (0 == core.index.cap)) {
+    return NULL;
+  }
+
+  for (uint32_t i = tfwm_index_hash(window);; i = (i + 1) & (core.index.cap - 1)) {
+    if (core.index.list[i].win == window) {
+      return &core.index.list[i];
+    }
+    if (0 == core.index.list[i].win) {
+      return NULL;
     }
   }
-  if (0 == ok) {
+}
+
+static tfwm_handle_t tfwm_index_get(xcb_window_t window) {
+  tfwm_index_entry_t *e = tfwm_index_find(window);
+  return e ? e->handle : 0;
+}
+
+static void tfwm_index_grow(void) {
+  tfwm_index_t old = core.index;
+  uint32_t cap = old.cap ? old.cap * 2 : TFWM_INDEX_ALLOC;
+  tfwm_index_entry_t *list = calloc(cap, sizeof(tfwm_index_entry_t));
+  if (!list) {
     return;
   }
 
-  core.prv_ws = core.cur_ws;
-  core.cur_ws = wsid;
-  if (core.ws_list[core.prv_ws].layout != core.ws_list[core.cur_ws].layout) {
-    tfwm_layout_update(core.cur_ws);
+  core.index.len = 0;
+  core.index.cap = cap;
+  core.index.list = list;
+  for (uint32_t i = 0; i < old.cap; i++) {
+    if (old.list[i].win) {
+      tfwm_index_put(old.list[i].win, old.list[i].handle);
+    }
   }
-  tfwm_workspace_window_unmap(core.prv_ws);
-  tfwm_workspace_window_map(core.cur_ws);
+  free(old.list);
 }
 
-void tfwm_workspace_next(char **cmd) {
-  if ((core.cur_ws + 1) == core.ws_len) {
-    core.prv_ws = core.cur_ws;
-    core.cur_ws = 0;
-  } else {
-    core.prv_ws = core.cur_ws;
-    core.cur_ws++;
+static void tfwm_index_put(xcb_window_t window, tfwm_handle_t handle) {
+  if (0 == window) {
+    return;
   }
-  if (core.ws_list[core.prv_ws].layout != core.ws_list[core.cur_ws].layout) {
-    tfwm_layout_update(core.cur_ws);
+  if ((core.index.len + 1) * 2 > core.index.cap) {
+    tfwm_index_grow();
   }
-  tfwm_workspace_window_unmap(core.prv_ws);
-  tfwm_workspace_window_map(core.cur_ws);
-}
 
-void tfwm_workspace_prev(char **cmd) {
-  if (0 == core.cur_ws) {
-    core.prv_ws = core.cur_ws;
-    core.cur_ws = core.ws_len - 1;
-  } else {
-    core.prv_ws = core.cur_ws;
-    core.cur_ws--;
+  uint32_t i = tfwm_index_hash(window);
+  while (core.index.list[i].win && (core.index.list[i].win != window)) {
+    i = (i + 1) & (core.index.cap - 1);
   }
-  if (core.ws_list[core.prv_ws].layout != core.ws_list[core.cur_ws].layout) {
-    tfwm_layout_update(core.cur_ws);
+  if (0 == core.index.list[i].win) {
+    core.index.len++;
   }
-  tfwm_workspace_window_unmap(core.prv_ws);
-  tfwm_workspace_window_map(core.cur_ws);
+  core.index.list[i] = (tfwm_index_entry_t){window, handle};
 }
 
-void tfwm_workspace_swap_prev(char **cmd) {
-  if ((core.prv_ws) == core.cur_ws) {
+static void tfwm_index_del(xcb_window_t window) {
+  tfwm_index_entry_t *e = tfwm_index_find(window);
+  if (!e) {
     return;
   }
 
-  core.prv_ws = core.prv_ws ^ core.cur_ws;
-  core.cur_ws = core.prv_ws ^ core.cur_ws;
-  core.prv_ws = core.prv_ws ^ core.cur_ws;
-  if (core.ws_list[core.prv_ws].layout != core.ws_list[core.cur_ws].layout) {
-    tfwm_layout_update(core.cur_ws);
+  uint32_t mask = core.index.cap - 1;
+  uint32_t i = e - core.index.list;
+  uint32_t j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (0 == core.index.list[j].win) {
+      break;
+    }
+    uint32_t k = tfwm_index_hash(core.index.list[j].win);
+    if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j))) {
+      continue;
+    }
+    core.index.list[i] = core.index.list[j];
+    i = j;
   }
-  tfwm_workspace_window_unmap(core.prv_ws);
-  tfwm_workspace_window_map(core.cur_ws);
+  core.index.list[i] = (tfwm_index_entry_t){0};
+  core.index.len--;
 }
 
-void tfwm_workspace_use_tiling(char **cmd) {
-  if (TFWM_LAYOUT_TILING == core.ws_list[core.cur_ws].layout) {
-    return;
-  }
-  core.ws_list[core.cur_ws].layout = TFWM_LAYOUT_TILING;
-  tfwm_layout_apply_tiling(core.cur_ws);
+static uint16_t tfwm_keyboard_clean_mask(uint16_t state) {
+  return state & ~core.kbd.lock_mask & 0xff;
 }
 
-void tfwm_workspace_use_floating(char **cmd) {
-  if (TFWM_LAYOUT_FLOATING == core.ws_list[core.cur_ws].layout) {
-    return;
-  }
-  core.ws_list[core.cur_ws].layout = TFWM_LAYOUT_FLOATING;
-}
+static void tfwm_keyboard_lock_mask(xcb_get_modifier_mapping_cookie_t ck) {
+  core.kbd.lock_mask = XCB_MOD_MASK_LOCK;
 
-void tfwm_workspace_use_window(char **cmd) {
-  if (TFWM_LAYOUT_WINDOW == core.ws_list[core.cur_ws].layout) {
+  xcb_get_modifier_mapping_reply_t *r =
+      xcb_get_modifier_mapping_reply(core.c, ck, NULL);
+  if (!r) {
+    return;
+  }
+
+  xcb_keycode_t *kc = xcb_get_modifier_mapping_keycodes(r);
+  for (int i = 0; i < 8; i++) {
+    for (int j = 0; j < r->keycodes_per_modifier; j++) {
+      xcb_keycode_t k = kc[i * r->keycodes_per_modifier + j];
+      if (XCB_NO_SYMBOL == k) {
+        continue;
+      }
+      xcb_keysym_t ks = xcb_key_symbols_get_keysym(core.kbd.syms, k, 0);
+      if ((TFWM_KEYSYM_NUM_LOCK == ks) || (TFWM_KEYSYM_SCROLL_LOCK == ks)) {
+        core.kbd.lock_mask |= (1 << i);
+      }
+    }
+  }
+  free(r);
+}
+
+static void tfwm_keyboard_grab_key(int kc, int mod, int grab) {
+  uint16_t lock = core.kbd.lock_mask & 0xff;
+  for (uint16_t m = lock;; m = (m - 1) & lock) {
+    if (!grab) {
+      xcb_ungrab_key(core.c, kc, core.sc->root, mod | m);
+    } else {
+      xcb_grab_key(
+          core.c,
+          1,
+          core.sc->root,
+          mod | m,
+          kc,
+          XCB_GRAB_MODE_ASYNC,
+          XCB_GRAB_MODE_ASYNC
+      );
+    }
+    if (0 == m) {
+      break;
+    }
+  }
+}
+
+static void tfwm_keyboard_grab(void) {
+  xcb_ungrab_key(core.c, XCB_GRAB_ANY, core.sc->root, XCB_MOD_MASK_ANY);
+  for (int i = 0; i < 256; i++) {
+    for (int j = 0; j < 256; j++) {
+      if (core.kbd.bind[i][j]) {
+        tfwm_keyboard_grab_key(i, j, 1);
+      }
+    }
+  }
+}
+
+static void tfwm_keyboard_regrab(uint16_t (*old)[256]) {
+  for (int i = 0; i < 256; i++) {
+    for (int j = 0; j < 256; j++) {
+      if (!old[i][j] != !core.kbd.bind[i][j]) {
+        tfwm_keyboard_grab_key(i, j, 0 != core.kbd.bind[i][j]);
+      }
+    }
+  }
+}
+
+static void tfwm_keyboard_map(void) {
+  memset(core.kbd.bind, 0, sizeof(core.kbd.bind));
+  for (int i = core.cfg->key_len - 1; i >= 0; i--) {
+    xcb_keycode_t *kc =
+        xcb_key_symbols_get_keycode(core.kbd.syms, core.cfg->keys[i].keysym);
+    if (!kc) {
+      continue;
+    }
+    uint16_t mod = tfwm_keyboard_clean_mask(core.cfg->keys[i].mod);
+    for (xcb_keycode_t *k = kc; *k != XCB_NO_SYMBOL; k++) {
+      core.kbd.bind[*k][mod] = i + 1;
+    }
+    free(kc);
+  }
+}
+
+static void tfwm_keyboard_load(xcb_get_modifier_mapping_cookie_t ck) {
+  if (!core.kbd.syms) {
+    core.kbd.syms = xcb_key_symbols_alloc(core.c);
+  }
+  if (!core.kbd.syms) {
+    TFWM_LOG(TFWM_LOG_ERROR, TFWM_SYS_KEYBOARD, "can not load keyboard mapping");
+    core.exit = EXIT_FAILURE;
+    xcb_discard_reply(core.c, ck.sequence);
+    return;
+  }
+
+  uint64_t t = tfwm_stats_roundtrip(TFWM_STAT_RT_KEYBOARD);
+  tfwm_keyboard_lock_mask(ck);
+  tfwm_trace_end(TFWM_TRACE_WAIT, TFWM_STAT_RT_KEYBOARD, t, 0);
+  tfwm_keyboard_map();
+  tfwm_keyboard_grab();
+}
+
+static void tfwm_config_default(tfwm_config_t *cfg) {
+  *cfg = (tfwm_config_t){0};
+  cfg->border_active = TFWM_BORDER_ACTIVE;
+  cfg->border_inactive = TFWM_BORDER_INACTIVE;
+  cfg->frame_background = TFWM_FRAME_BACKGROUND;
+  cfg->bar_foreground = TFWM_BAR_FOREGROUND;
+  cfg->bar_background = TFWM_BAR_BACKGROUND;
+  cfg->bar_foreground_active = TFWM_BAR_FOREGROUND_ACTIVE;
+  cfg->bar_background_active = TFWM_BAR_BACKGROUND_ACTIVE;
+  cfg->tile_master = TFWM_TILE_MASTER;
+  cfg->key_len = ARRAY_LENGTH(cfg_keybinds);
+  cfg->keys = cfg_keybinds;
+}
+
+static char *tfwm_config_path(void) {
+  char *home = getenv("HOME");
+  if (!home) {
+    return NULL;
+  }
+  char *path = malloc(strlen(home) + strlen(TFWM_CONFIG_FILE) + 2);
+  if (path) {
+    sprintf(path, "%s/%s", home, TFWM_CONFIG_FILE);
+  }
+  return path;
+}
+
+static int tfwm_config_key(char *s, uint16_t *mod, xcb_keysym_t *keysym) {
+  char *save;
+  char *name = NULL;
+  *mod = 0;
+  for (char *t = strtok_r(s, "+", &save); t; t = strtok_r(NULL, "+", &save)) {
+    if (name) {
+      size_t i = 0;
+      while ((i < ARRAY_LENGTH(TFWM_CONFIG_MOD)) &&
+             (strcmp(name, TFWM_CONFIG_MOD[i].name) != 0)) {
+        i++;
+      }
+      if (ARRAY_LENGTH(TFWM_CONFIG_MOD) == i) {
+        return -1;
+      }
+      *mod |= TFWM_CONFIG_MOD[i].value;
+    }
+    name = t;
+  }
+  if (!name) {
+    return -1;
+  }
+
+  if ((1 == strlen(name)) && (name[0] > 0x20) && (name[0] < 0x7f)) {
+    *keysym = name[0];
+    return 0;
+  }
+  if (strncmp(name, "0x", 2) == 0) {
+    char *end;
+    *keysym = strtoul(name, &end, 16);
+    return *end ? -1 : 0;
+  }
+  int f = 0;
+  if ((sscanf(name, "F%d", &f) == 1) && (f >= 1) && (f <= 12)) {
+    *keysym = 0xffbd + f;
+    return 0;
+  }
+  for (size_t i = 0; i < ARRAY_LENGTH(TFWM_CONFIG_KEYSYM); i++) {
+    if (strcmp(name, TFWM_CONFIG_KEYSYM[i].name) == 0) {
+      *keysym = TFWM_CONFIG_KEYSYM[i].value;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static int tfwm_config_bind(tfwm_config_t *cfg, char **save) {
+  char *key = strtok_r(NULL, " \t\r", save);
+  char *name = strtok_r(NULL, " \t\r", save);
+  if (!key || !name) {
+    return -1;
+  }
+
+  tfwm_keybind_t *kb = &cfg->key_buf[cfg->key_len];
+  if (tfwm_config_key(key, &kb->mod, &kb->keysym) < 0) {
+    return -1;
+  }
+  for (size_t i = 0; i < ARRAY_LENGTH(TFWM_COMMAND); i++) {
+    if (strcmp(name, TFWM_COMMAND[i].name) == 0) {
+      kb->func = TFWM_COMMAND[i].func;
+      break;
+    }
+  }
+  if (!kb->func) {
+    return -1;
+  }
+
+  const char **args = cfg->args + cfg->arg_len;
+  int argc = 0;
+  for (char *a = strtok_r(NULL, " \t\r", save); a;
+       a = strtok_r(NULL, " \t\r", save)) {
+    args[argc++] = a;
+  }
+  for (size_t i = 0; i < ARRAY_LENGTH(TFWM_COMMAND); i++) {
+    if ((kb->func == TFWM_COMMAND[i].func) && (argc < TFWM_COMMAND[i].argc)) {
+      return -1;
+    }
+  }
+  if (argc > 0) {
+    kb->cmd = args;
+    cfg->arg_len += argc + 1;
+  }
+  cfg->key_len++;
+  return 0;
+}
+
+static int tfwm_config_line(tfwm_config_t *cfg, char *line) {
+  char *save;
+  char *key = strtok_r(line, " \t\r", &save);
+  if (!key || ('#' == key[0])) {
+    return 0;
+  }
+  if (strcmp(key, "bind") == 0) {
+    return tfwm_config_bind(cfg, &save);
+  }
+
+  char *val = strtok_r(NULL, " \t\r", &save);
+  if (!val) {
+    return -1;
+  }
+  char *end;
+  if (strcmp(key, "tile_master") == 0) {
+    double d = strtod(val, &end);
+    if (*end || (d <= 0) || (d >= 100)) {
+      return -1;
+    }
+    cfg->tile_master = d;
+    return 0;
+  }
+  for (size_t i = 0; i < ARRAY_LENGTH(TFWM_CONFIG_COLOR); i++) {
+    if (strcmp(key, TFWM_CONFIG_COLOR[i].name) == 0) {
+      char *start = ('#' == val[0]) ? val + 1 : val;
+      unsigned long c = strtoul(start, &end, 16);
+      if (!isxdigit((unsigned char)*start) || (end == start) || *end ||
+          (c > 0xffffff)) {
+        return -1;
+      }
+      *(uint32_t *)((char *)cfg + TFWM_CONFIG_COLOR[i].offset) = c;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static tfwm_config_t *tfwm_config_parse(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return NULL;
+  }
+  char *text = NULL;
+  size_t cap = 0;
+  ssize_t len = getdelim(&text, &cap, '\0', f);
+  fclose(f);
+
+  tfwm_config_t *cfg = malloc(sizeof(tfwm_config_t));
+  if (!cfg || (len < 0)) {
+    free(text);
+    free(cfg);
+    return NULL;
+  }
+  size_t lines = 1;
+  for (ssize_t i = 0; i < len; i++) {
+    lines += ('\n' == text[i]);
+  }
+  tfwm_config_default(cfg);
+  cfg->text = text;
+  cfg->key_len = 0;
+  cfg->key_buf = calloc(lines, sizeof(tfwm_keybind_t));
+  cfg->args = calloc(len + 2, sizeof(char *));
+  if (!cfg->key_buf || !cfg->args) {
+    tfwm_config_free(cfg);
+    return NULL;
+  }
+
+  int n = 0;
+  for (char *line = text, *next; line; line = next) {
+    next = strchr(line, '\n');
+    if (next) {
+      *next++ = '\0';
+    }
+    n++;
+    if (tfwm_config_line(cfg, line) < 0) {
+      TFWM_LOG(TFWM_LOG_WARN, TFWM_SYS_CONFIG, "%s:%d: invalid line", path, n);
+      tfwm_config_free(cfg);
+      return NULL;
+    }
+  }
+
+  cfg->keys = cfg->key_buf;
+  if (0 == cfg->key_len) {
+    cfg->key_len = ARRAY_LENGTH(cfg_keybinds);
+    cfg->keys = cfg_keybinds;
+  }
+  return cfg;
+}
+
+static void tfwm_config_free(tfwm_config_t *cfg) {
+  if (!cfg) {
+    return;
+  }
+  free(cfg->key_buf);
+  free(cfg->args);
+  free(cfg->text);
+  free(cfg);
+}
+
+static void tfwm_config_apply(tfwm_config_t *cfg) {
+  tfwm_config_t *old = core.cfg;
+  core.cfg = cfg;
+  if (!old) {
+    return;
+  }
+
+  uint16_t (*bind)[256] = malloc(sizeof(core.kbd.bind));
+  if (bind) {
+    memcpy(bind, core.kbd.bind, sizeof(core.kbd.bind));
+    tfwm_keyboard_map();
+    tfwm_keyboard_regrab(bind);
+    free(bind);
+  }
+
+  uint32_t acvs[2] = {cfg->bar_foreground_active, cfg->bar_background_active};
+  uint32_t invs[2] = {cfg->bar_foreground, cfg->bar_background};
+  uint32_t mask = XCB_GC_FOREGROUND | XCB_GC_BACKGROUND;
+  xcb_change_gc(core.c, core.gc_active, mask, acvs);
+  xcb_change_gc(core.c, core.gc_inactive, mask, invs);
+  xcb_change_gc(core.c, core.gc_background, XCB_GC_FOREGROUND, invs + 1);
+  for (uint32_t i = 0; i < core.out_len; i++) {
+    xcb_change_window_attributes(
+        core.c, core.out_list[i].bar, XCB_CW_BACK_PIXEL, invs + 1
+    );
+  }
+
+  uint32_t fvs[2] = {cfg->frame_background, cfg->border_inactive};
+  for (uint32_t i = 0; i < core.arena.len; i++) {
+    if (core.arena.list[i].win) {
+      xcb_change_window_attributes(
+          core.c,
+          core.arena.list[i].frame,
+          XCB_CW_BACK_PIXEL | XCB_CW_BORDER_PIXEL,
+          fvs
+      );
+    }
+  }
+  tfwm_window_color(core.win, cfg->border_active);
+
+  if (cfg->tile_master != old->tile_master) {
+    for (uint32_t i = 0; i < core.ws_len; i++) {
+      tfwm_layout_update(i);
+    }
+  }
+  core.bar_dirty = TFWM_BAR_ALL;
+  tfwm_config_free(old);
+}
+
+static void tfwm_config_load(void) {
+  char *path = tfwm_config_path();
+  tfwm_config_t *cfg = path ? tfwm_config_parse(path) : NULL;
+  if (cfg) {
+    TFWM_LOG(TFWM_LOG_INFO, TFWM_SYS_CONFIG, "loaded %s", path);
+  } else if (!core.cfg) {
+    cfg = malloc(sizeof(tfwm_config_t));
+    if (!cfg) {
+      TFWM_LOG(TFWM_LOG_ERROR, TFWM_SYS_CONFIG, "can not allocate config");
+      core.exit = EXIT_FAILURE;
+      free(path);
+      return;
+    }
+    tfwm_config_default(cfg);
+  }
+  if (cfg) {
+    tfwm_config_apply(cfg);
+  }
+  free(path);
+}
+
+static void tfwm_config_watch(void) {
+  core.cfg_fd = -1;
+  char *path = tfwm_config_path();
+  char *dir = path ? strrchr(path, '/') : NULL;
+  if (!dir) {
+    free(path);
+    return;
+  }
+
+  *dir = '\0';
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if ((fd < 0) || (inotify_add_watch(fd, path, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) ||
+      (tfwm_loop_add(fd, EPOLLIN, tfwm_config_signal) < 0)) {
+    TFWM_LOG(TFWM_LOG_INFO, TFWM_SYS_CONFIG, "not watching %s", path);
+    if (fd >= 0) {
+      close(fd);
+    }
+    free(path);
+    return;
+  }
+  core.cfg_fd = fd;
+  free(path);
+}
+
+static void tfwm_config_signal(int fd, uint32_t events) {
+  const char *base = strrchr(TFWM_CONFIG_FILE, '/');
+  base = base ? base + 1 : TFWM_CONFIG_FILE;
+
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  int changed = 0;
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    for (char *p = buf; p < buf + n;) {
+      struct inotify_event *ev = (struct inotify_event *)p;
+      if (ev->len && (strcmp(ev->name, base) == 0)) {
+        changed = 1;
+      }
+      p += sizeof(struct inotify_event) + ev->len;
+    }
+  }
+  if (changed) {
+    tfwm_config_load();
+  }
+}
+
+static void tfwm_config_cleanup(void) {
+  if (core.cfg_fd >= 0) {
+    close(core.cfg_fd);
+  }
+  tfwm_config_free(core.cfg);
+  core.cfg = NULL;
+}
+
+static void tfwm_journal_open(void) {
+  char *home = getenv("HOME");
+  if (!home) {
+    return;
+  }
+  char display[TFWM_DISPLAY_LEN];
+  tfwm_util_display(display, sizeof(display));
+  char path[strlen(home) + strlen(TFWM_JOURNAL_FILE) + strlen(display) + 2];
+  int len = sprintf(path, "%s/", home);
+  sprintf(path + len, TFWM_JOURNAL_FILE, display);
+  core.journal.fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (core.journal.fd < 0) {
+    TFWM_LOG(TFWM_LOG_WARN, TFWM_SYS_JOURNAL, "can not open %s", path);
+    return;
+  }
+  if (flock(core.journal.fd, LOCK_EX | LOCK_NB) < 0) {
+    TFWM_LOG(TFWM_LOG_WARN, TFWM_SYS_JOURNAL, "%s is in use", path);
+    close(core.journal.fd);
+    core.journal.fd = -1;
+    return;
+  }
+
+  struct stat st;
+  size_t size = sizeof(tfwm_journal_file_t);
+  if ((fstat(core.journal.fd, &st) < 0) ||
+      (((size_t)st.st_size != size) && (ftruncate(core.journal.fd, size) < 0))) {
+    TFWM_LOG(TFWM_LOG_WARN, TFWM_SYS_JOURNAL, "can not resize %s", path);
+    close(core.journal.fd);
+    core.journal.fd = -1;
+    return;
+  }
+  void *map =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, core.journal.fd, 0);
+  if (MAP_FAILED == map) {
+    TFWM_LOG(TFWM_LOG_WARN, TFWM_SYS_JOURNAL, "can not map %s", path);
+    close(core.journal.fd);
+    core.journal.fd = -1;
+    return;
+  }
+
+  core.journal.map = map;
+  if ((TFWM_JOURNAL_MAGIC != core.journal.map->magic) ||
+      (size != core.journal.map->size)) {
+    memset(map, 0, size);
+    core.journal.map->magic = TFWM_JOURNAL_MAGIC;
+    core.journal.map->size = size;
+  }
+}
+
+static tfwm_journal_entry_t *tfwm_journal_entry(tfwm_window_t *w) {
+  if (!core.journal.map) {
+    return NULL;
+  }
+
+  for (uint32_t i = 0; (0 == w->slot) && (i < TFWM_JOURNAL_WINDOWS); i++) {
+    uint32_t n = (core.journal.next + i) % TFWM_JOURNAL_WINDOWS;
+    if (0 == core.journal.map->list[n].win) {
+      w->slot = n + 1;
+      core.journal.next = n + 1;
+    }
+  }
+  if (0 == w->slot) {
+    return NULL;
+  }
+  return &core.journal.map->list[w->slot - 1];
+}
+
+static void tfwm_journal_window(tfwm_window_t *w) {
+  tfwm_journal_entry_t *j = tfwm_journal_entry(w);
+  if (!j) {
+    return;
+  }
+
+  j->wsid = w->wsid;
+  j->x = w->x;
+  j->y = w->y;
+  j->w = w->w;
+  j->h = w->h;
+  j->cw = w->cw;
+  j->ch = w->ch;
+  j->win = w->win;
+}
+
+static void tfwm_journal_forget(tfwm_window_t *w) {
+  if (core.journal.map && w->slot) {
+    core.journal.map->list[w->slot - 1].win = 0;
+  }
+  w->slot = 0;
+}
+
+static void tfwm_journal_workspace(uint32_t wsid) {
+  if (!core.journal.map) {
+    return;
+  }
+
+  tfwm_workspace_t *ws = &core.ws_list[wsid];
+  if (wsid < TFWM_JOURNAL_WORKSPACES) {
+    core.journal.map->layout[wsid] = ws->layout + 1;
+  }
+  core.journal.map->cur_ws = core.cur_ws;
+
+  uint32_t pos = 0;
+  tfwm_window_t *w = tfwm_arena_get(ws->head);
+  for (; w; w = tfwm_arena_get(w->next)) {
+    tfwm_journal_window(w);
+    if (w->slot) {
+      core.journal.map->list[w->slot - 1].pos = pos++;
+    }
+  }
+}
+
+static int tfwm_journal_compare(const void *a, const void *b) {
+  tfwm_journal_entry_t *x = &core.journal.map->list[*(uint32_t *)a];
+  tfwm_journal_entry_t *y = &core.journal.map->list[*(uint32_t *)b];
+  if ((x->wsid) != y->wsid) {
+    return (x->wsid < y->wsid) ? -1 : 1;
+  }
+  if ((x->pos) != y->pos) {
+    return (x->pos < y->pos) ? -1 : 1;
+  }
+  return (*(uint32_t *)a < *(uint32_t *)b) ? -1 : 1;
+}
+
+static int tfwm_journal_compare_window(const void *a, const void *b) {
+  xcb_window_t x = *(xcb_window_t *)a;
+  xcb_window_t y = *(xcb_window_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void tfwm_journal_session(xcb_get_property_reply_t *r) {
+  tfwm_journal_file_t *jf = core.journal.map;
+  if (!jf) {
+    free(r);
+    return;
+  }
+
+  if (!r || (xcb_get_property_value_length(r) < 4) ||
+      (*(uint32_t *)xcb_get_property_value(r) != jf->session)) {
+    memset(jf->list, 0, sizeof(jf->list));
+    jf->session = (uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16);
+    xcb_change_property(
+        core.c,
+        XCB_PROP_MODE_REPLACE,
+        core.sc->root,
+        core.atom[TFWM_ATOM_TFWM_SESSION],
+        XCB_ATOM_CARDINAL,
+        32,
+        1,
+        &jf->session
+    );
+  }
+  free(r);
+
+  for (uint32_t i = 0; (i < core.ws_len) && (i < TFWM_JOURNAL_WORKSPACES); i++) {
+    if (jf->layout[i] && (jf->layout[i] <= TFWM_LAYOUT_WINDOW + 1)) {
+      core.ws_list[i].layout = jf->layout[i] - 1;
+    }
+  }
+}
+
+static uint32_t tfwm_journal_order(xcb_window_t *children, int n, uint32_t *order) {
+  tfwm_journal_file_t *jf = core.journal.map;
+  if (!jf) {
+    return 0;
+  }
+
+  xcb_window_t sorted[n + 1];
+  memcpy(sorted, children, n * sizeof(xcb_window_t));
+  qsort(sorted, n, sizeof(xcb_window_t), tfwm_journal_compare_window);
+
+  uint32_t len = 0;
+  for (uint32_t i = 0; i < TFWM_JOURNAL_WINDOWS; i++) {
+    tfwm_journal_entry_t *j = &jf->list[i];
+    if (0 == j->win) {
+      continue;
+    }
+    if (!bsearch(
+            &j->win, sorted, n, sizeof(xcb_window_t), tfwm_journal_compare_window
+        )) {
+      j->win = 0;
+      continue;
+    }
+    order[len++] = i;
+  }
+  qsort(order, len, sizeof(uint32_t), tfwm_journal_compare);
+  return len;
+}
+
+static void tfwm_journal_release(void) {
+  for (uint32_t i = 0; i < core.arena.len; i++) {
+    tfwm_window_t *w = &core.arena.list[i];
+    if (0 == w->win) {
+      continue;
+    }
+    tfwm_geometry_t *g = &core.ws_list[w->wsid].geom;
+    xcb_reparent_window(core.c, w->win, core.sc->root, g->x + w->x, g->y + w->y);
+  }
+  free(xcb_get_input_focus_reply(core.c, xcb_get_input_focus(core.c), NULL));
+}
+
+static void tfwm_journal_cleanup(void) {
+  if (core.journal.map) {
+    munmap(core.journal.map, sizeof(tfwm_journal_file_t));
+  }
+  if (core.journal.fd >= 0) {
+    close(core.journal.fd);
+  }
+}
+
+void tfwm_exit(char **cmd) {
+  core.quit = 1;
+}
+
+void tfwm_restart(char **cmd) {
+  core.restart = 1;
+  core.quit = 1;
+}
+
+void tfwm_config_reload(char **cmd) {
+  tfwm_config_load();
+}
+
+void tfwm_trace_start(char **cmd) {
+  if (core.trace.list) {
+    return;
+  }
+  core.trace.head = 0;
+  core.trace.list = calloc(TFWM_TRACE_SPANS, sizeof(tfwm_trace_span_t));
+}
+
+void tfwm_trace_stop(char **cmd) {
+  if (!core.trace.list) {
+    return;
+  }
+  tfwm_trace_write();
+  free(core.trace.list);
+  core.trace.list = NULL;
+}
+
+void tfwm_log_level(char **cmd) {
+  for (int i = 0; i < TFWM_LOG_LEN; i++) {
+    if (strcmp(cmd[0], TFWM_LOG_NAME[i]) == 0) {
+      core.log.level = i;
+    }
+  }
+}
+
+void tfwm_window_spawn(char **cmd) {
+  tfwm_launch(cmd);
+}
+
+void tfwm_window_kill(char **cmd) {
+  if (0 == core.win) {
+    return;
+  }
+  if ((core.win) == core.sc->root) {
+    return;
+  }
+
+  xcb_window_t tgt = core.win;
+  xcb_kill_client(core.c, tgt);
+  tfwm_window_unmanage(tgt);
+}
+
+void tfwm_window_next(char **cmd) {
+  tfwm_window_t *w = tfwm_arena_get(tfwm_index_get(core.win));
+  if (!w) {
+    return;
+  }
+
+  if (0 == w->next) {
+    tfwm_window_focus(tfwm_arena_get(core.ws_list[w->wsid].head)->win);
+  } else {
+    tfwm_window_focus(tfwm_arena_get(w->next)->win);
+  }
+}
+
+void tfwm_window_prev(char **cmd) {
+  tfwm_window_t *w = tfwm_arena_get(tfwm_index_get(core.win));
+  if (!w) {
+    return;
+  }
+
+  if (0 == w->prev) {
+    tfwm_window_focus(tfwm_arena_get(core.ws_list[w->wsid].tail)->win);
+  } else {
+    tfwm_window_focus(tfwm_arena_get(w->prev)->win);
+  }
+}
+
+void tfwm_window_swap_last(char **cmd) {
+  if (core.ws_list[core.cur_ws].win_len < 2) {
+    return;
+  }
+
+  tfwm_handle_t h = tfwm_index_get(core.win);
+  tfwm_window_t *w = tfwm_arena_get(h);
+  if (!w) {
+    return;
+  }
+  uint32_t wsid = w->wsid;
+  tfwm_workspace_t *ws = &core.ws_list[wsid];
+  tfwm_handle_t last = ws->tail;
+  if ((h) == last) {
+    return;
+  }
+
+  tfwm_handle_t prev = w->prev;
+  tfwm_workspace_window_pop(h);
+  tfwm_workspace_window_append(wsid, h);
+  tfwm_workspace_window_pop(last);
+  tfwm_workspace_window_insert(wsid, last, prev);
+  if (TFWM_LAYOUT_TILING == ws->layout) {
+    tfwm_layout_apply_tiling(core.cur_ws);
+  }
+  tfwm_window_focus(core.win);
+}
+
+void tfwm_window_fullscreen(char **cmd) {
+  if (0 == core.win) {
+    return;
+  }
+  if ((core.win) == core.sc->root) {
+    return;
+  }
+
+  tfwm_window_t *win = tfwm_arena_get(core.cur_win);
+  if (!win) {
+    return;
+  }
+  int x = 0 - TFWM_BORDER_WIDTH;
+  int y = 0 - TFWM_BORDER_WIDTH;
+  int w = core.ws_list[win->wsid].geom.w;
+  int h = core.ws_list[win->wsid].geom.h;
+
+  if (1 == win->is_fullscreen) {
+    x = win->x;
+    y = win->y;
+    w = win->w;
+    h = win->h;
+  }
+
+  tfwm_window_configure(core.win, x, y, w, h);
+  win->is_fullscreen ^= 1;
+  tfwm_workspace_restack(win->wsid);
+}
+
+void tfwm_window_to_workspace(char **cmd) {
+  uint32_t wsid = 0;
+  uint8_t ok = 0;
+  for (uint32_t i = 0; i < core.ws_len; i++) {
+    if (strcmp((char *)cmd[0], core.ws_list[i].name) == 0) {
+      if (i == core.cur_ws) {
+        return;
+      }
+      wsid = i;
+      ok = 1;
+      break;
+    }
+  }
+  if (0 == ok) {
+    return;
+  }
+  tfwm_handle_t h = tfwm_index_get(core.win);
+  tfwm_window_t *w = tfwm_arena_get(h);
+  if (!w) {
+    return;
+  }
+
+  uint32_t from = w->wsid;
+  tfwm_workspace_window_pop(h);
+  tfwm_workspace_window_append(wsid, h);
+  xcb_reparent_window(core.c, w->frame, core.ws_list[wsid].container, w->x, w->y);
+  tfwm_layout_update(from);
+  tfwm_layout_update(wsid);
+  tfwm_workspace_restack(from);
+  tfwm_workspace_restack(wsid);
+  tfwm_workspace_activate(wsid);
+}
+
+void tfwm_workspace_switch(char **cmd) {
+  uint32_t wsid = 0;
+  uint8_t ok = 0;
+  for (uint32_t i = 0; i < core.ws_len; i++) {
+    if (strcmp((char *)cmd[0], core.ws_list[i].name) == 0) {
+      if (i == core.cur_ws) {
+        return;
+      }
+      wsid = i;
+      ok = 1;
+      break;
+    }
+  }
+  if (0 == ok) {
+    return;
+  }
+
+  tfwm_workspace_activate(wsid);
+}
+
+void tfwm_workspace_next(char **cmd) {
+  if ((core.cur_ws + 1) == core.ws_len) {
+    tfwm_workspace_activate(0);
+  } else {
+    tfwm_workspace_activate(core.cur_ws + 1);
+  }
+}
+
+void tfwm_workspace_prev(char **cmd) {
+  if (0 == core.cur_ws) {
+    tfwm_workspace_activate(core.ws_len - 1);
+  } else {
+    tfwm_workspace_activate(core.cur_ws - 1);
+  }
+}
+
+void tfwm_workspace_swap_prev(char **cmd) {
+  if ((core.prv_ws) == core.cur_ws) {
+    return;
+  }
+
+  tfwm_workspace_activate(core.prv_ws);
+}
+
+void tfwm_workspace_use_tiling(char **cmd) {
+  if (TFWM_LAYOUT_TILING == core.ws_list[core.cur_ws].layout) {
+    return;
+  }
+  core.ws_list[core.cur_ws].layout = TFWM_LAYOUT_TILING;
+  core.bar_dirty |= TFWM_BAR_LAYOUT;
+  tfwm_journal_workspace(core.cur_ws);
+  tfwm_layout_apply_tiling(core.cur_ws);
+}
+
+void tfwm_workspace_use_floating(char **cmd) {
+  if (TFWM_LAYOUT_FLOATING == core.ws_list[core.cur_ws].layout) {
+    return;
+  }
+  core.ws_list[core.cur_ws].layout = TFWM_LAYOUT_FLOATING;
+  core.bar_dirty |= TFWM_BAR_LAYOUT;
+  tfwm_journal_workspace(core.cur_ws);
+}
+
+void tfwm_workspace_use_window(char **cmd) {
+  if (TFWM_LAYOUT_WINDOW == core.ws_list[core.cur_ws].layout) {
     return;
   }
   core.ws_list[core.cur_ws].layout = TFWM_LAYOUT_WINDOW;
+  core.bar_dirty |= TFWM_BAR_LAYOUT;
+  tfwm_journal_workspace(core.cur_ws);
   tfwm_layout_apply_window(core.cur_ws);
 }
 
-static void tfwm_window_focus(xcb_window_t window) {
-  if (0 == window) {
+static void tfwm_window_focus(xcb_window_t window) {
+  if (0 == window) {
+    return;
+  }
+
+  xcb_set_input_focus(
+      core.c, XCB_INPUT_FOCUS_POINTER_ROOT, window, XCB_CURRENT_TIME
+  );
+  if ((window) == core.sc->root) {
+    core.win = window;
+    core.cur_win = 0;
+  } else {
+    tfwm_handle_t h = tfwm_index_get(window);
+    tfwm_window_t *w = tfwm_arena_get(h);
+    if (w && (w->wsid != core.cur_ws) && tfwm_workspace_visible(w->wsid)) {
+      core.prv_ws = core.cur_ws;
+      core.cur_ws = w->wsid;
+      core.cur_out = core.ws_list[w->wsid].out;
+      core.bar_dirty |= TFWM_BAR_WORKSPACE | TFWM_BAR_LAYOUT;
+    }
+    if (w && (w->wsid == core.cur_ws)) {
+      core.win = window;
+      core.cur_win = h;
+      core.ws_list[w->wsid].focus = h;
+    }
+
+    if (w) {
+      uint32_t vs[1] = {XCB_STACK_MODE_ABOVE};
+      xcb_configure_window(core.c, w->frame, XCB_CONFIG_WINDOW_STACK_MODE, vs);
+    }
+  }
+  core.bar_dirty |= TFWM_BAR_TABS;
+}
+
+static void tfwm_window_color(xcb_window_t window, uint32_t color) {
+  if (TFWM_BORDER_WIDTH <= 0) {
+    return;
+  }
+  if (0 == window) {
+    return;
+  }
+  tfwm_window_t *w = tfwm_arena_get(tfwm_index_get(window));
+  if (!w) {
+    return;
+  }
+
+  uint32_t vs[1] = {color};
+  xcb_change_window_attributes(core.c, w->frame, XCB_CW_BORDER_PIXEL, vs);
+}
+
+static void tfwm_window_configure(xcb_window_t window, int x, int y, int w, int h) {
+  tfwm_window_t *win = tfwm_arena_get(tfwm_index_get(window));
+  if (!win) {
+    return;
+  }
+
+  w = MAX(w, (int)TFWM_MIN_WINDOW_WIDTH);
+  h = MAX(h, (int)TFWM_MIN_WINDOW_HEIGHT);
+  uint32_t vs[4] = {x, y, w, h};
+  xcb_configure_window(
+      core.c,
+      win->frame,
+      XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH |
+          XCB_CONFIG_WINDOW_HEIGHT,
+      vs
+  );
+  if ((w != win->cw) || (h != win->ch)) {
+    win->cw = w;
+    win->ch = h;
+    xcb_configure_window(
+        core.c,
+        win->win,
+        XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+        vs + 2
+    );
+    return;
+  }
+
+  xcb_configure_notify_event_t e = {0};
+  e.response_type = XCB_CONFIGURE_NOTIFY;
+  e.event = win->win;
+  e.window = win->win;
+  e.x = core.ws_list[win->wsid].geom.x + x + win->b;
+  e.y = core.ws_list[win->wsid].geom.y + y + win->b;
+  e.width = w;
+  e.height = h;
+  xcb_send_event(
+      core.c, 0, win->win, XCB_EVENT_MASK_STRUCTURE_NOTIFY, (char *)&e
+  );
+}
+
+static void tfwm_window_set_attr(xcb_window_t window, int x, int y, int w, int h) {
+  tfwm_window_t *win = tfwm_arena_get(tfwm_index_get(window));
+  if (!win) {
+    return;
+  }
+
+  win->x = x;
+  win->y = y;
+  win->w = w;
+  win->h = h;
+  tfwm_journal_window(win);
+}
+
+static void tfwm_window_unmanage(xcb_window_t window) {
+  tfwm_handle_t h = tfwm_index_get(window);
+  tfwm_window_t *w = tfwm_arena_get(h);
+  if (!w) {
+    return;
+  }
+
+  uint32_t wsid = w->wsid;
+  tfwm_handle_t next = w->next ? w->next : w->prev;
+  window = w->win;
+  TFWM_LOG(TFWM_LOG_DEBUG, TFWM_SYS_WINDOW, "unmanage 0x%x", window);
+  free(w->class);
+  xcb_destroy_window(core.c, w->frame);
+  tfwm_workspace_window_pop(h);
+  tfwm_journal_forget(w);
+  tfwm_index_del(window);
+  tfwm_index_del(w->frame);
+  tfwm_arena_free(h);
+  tfwm_workspace_restack(wsid);
+  if (wsid != core.cur_ws) {
+    return;
+  }
+
+  if ((window) == core.win) {
+    if (0 == next) {
+      tfwm_window_focus(core.sc->root);
+    } else {
+      tfwm_window_focus(tfwm_arena_get(next)->win);
+    }
+  }
+  tfwm_layout_update(wsid);
+}
+
+static void tfwm_workspace_activate(uint32_t wsid) {
+  core.prv_ws = core.cur_ws;
+  core.cur_ws = wsid;
+  if (tfwm_workspace_visible(wsid)) {
+    core.cur_out = core.ws_list[wsid].out;
+  } else {
+    tfwm_output_t *o = &core.out_list[core.cur_out];
+    uint32_t old = o->wsid;
+    o->wsid = wsid;
+    tfwm_workspace_place(wsid, core.cur_out);
+    if (core.ws_list[old].layout != core.ws_list[wsid].layout) {
+      tfwm_layout_update(wsid);
+    }
+    xcb_unmap_window(core.c, core.ws_list[old].container);
+    xcb_map_window(core.c, core.ws_list[wsid].container);
+  }
+
+  tfwm_workspace_t *ws = &core.ws_list[core.cur_ws];
+  tfwm_window_t *w = tfwm_arena_get(ws->focus);
+  if (!w) {
+    w = tfwm_arena_get(ws->tail);
+  }
+  tfwm_window_focus(w ? w->win : core.sc->root);
+  core.bar_dirty |= TFWM_BAR_WORKSPACE | TFWM_BAR_LAYOUT | TFWM_BAR_TABS;
+  tfwm_journal_workspace(wsid);
+}
+
+static void tfwm_workspace_container(uint32_t wsid) {
+  tfwm_workspace_t *ws = &core.ws_list[wsid];
+  ws->container = xcb_generate_id(core.c);
+  uint32_t vs[3] = {
+      XCB_BACK_PIXMAP_PARENT_RELATIVE,
+      1,
+      XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY
+  };
+  xcb_create_window(
+      core.c,
+      XCB_COPY_FROM_PARENT,
+      ws->container,
+      core.sc->root,
+      0,
+      0,
+      core.root_w,
+      core.root_h,
+      0,
+      XCB_WINDOW_CLASS_INPUT_OUTPUT,
+      core.sc->root_visual,
+      XCB_CW_BACK_PIXMAP | XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK,
+      vs
+  );
+
+  for (size_t i = 0; i < 2; i++) {
+    xcb_grab_button(
+        core.c,
+        0,
+        ws->container,
+        XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE,
+        XCB_GRAB_MODE_ASYNC,
+        XCB_GRAB_MODE_ASYNC,
+        core.sc->root,
+        XCB_NONE,
+        (0 == i) ? BTN_LEFT : BTN_RIGHT,
+        MOD_KEY
+    );
+  }
+}
+
+static void tfwm_workspace_restack(uint32_t wsid) {
+  tfwm_workspace_t *ws = &core.ws_list[wsid];
+  uint8_t raised = 0;
+  tfwm_window_t *w = tfwm_arena_get(ws->head);
+  for (; w; w = tfwm_arena_get(w->next)) {
+    if (w->is_fullscreen) {
+      raised = 1;
+      break;
+    }
+  }
+  if ((raised) == ws->raised) {
+    return;
+  }
+
+  uint32_t vs[2] = {
+      core.out_list[ws->out].bar,
+      raised ? XCB_STACK_MODE_ABOVE : XCB_STACK_MODE_BELOW
+  };
+  xcb_configure_window(
+      core.c,
+      ws->container,
+      XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE,
+      vs
+  );
+  ws->raised = raised;
+}
+
+static int tfwm_workspace_visible(uint32_t wsid) {
+  return core.out_list[core.ws_list[wsid].out].wsid == wsid;
+}
+
+static void tfwm_workspace_place(uint32_t wsid, uint32_t oid) {
+  tfwm_workspace_t *ws = &core.ws_list[wsid];
+  tfwm_geometry_t *g = &core.out_list[oid].geom;
+  if ((oid) != ws->out) {
+    ws->out = oid;
+    if (ws->raised) {
+      ws->raised = 0;
+      tfwm_workspace_restack(wsid);
+    }
+  }
+  if ((ws->geom.x == g->x) && (ws->geom.y == g->y) && (ws->geom.w == g->w) &&
+      (ws->geom.h == g->h)) {
+    return;
+  }
+
+  ws->geom = *g;
+  uint32_t vs[4] = {g->x, g->y, g->w, g->h};
+  xcb_configure_window(
+      core.c,
+      ws->container,
+      XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH |
+          XCB_CONFIG_WINDOW_HEIGHT,
+      vs
+  );
+  tfwm_layout_update(wsid);
+}
+
+static uint32_t tfwm_output_query(tfwm_output_t **list) {
+  uint32_t n = 0;
+  *list = NULL;
+  if (core.randr) {
+    uint64_t t = tfwm_stats_roundtrip(TFWM_STAT_RT_OUTPUT);
+    xcb_randr_get_monitors_reply_t *r = xcb_randr_get_monitors_reply(
+        core.c, xcb_randr_get_monitors(core.c, core.sc->root, 1), NULL
+    );
+    tfwm_trace_end(TFWM_TRACE_WAIT, TFWM_STAT_RT_OUTPUT, t, 0);
+    if (r) {
+      uint32_t len = xcb_randr_get_monitors_monitors_length(r);
+      len = (len < core.ws_len) ? len : core.ws_len;
+      *list = calloc(len ? len : 1, sizeof(tfwm_output_t));
+      xcb_randr_monitor_info_iterator_t it =
+          xcb_randr_get_monitors_monitors_iterator(r);
+      for (; it.rem && *list && (n < len); xcb_randr_monitor_info_next(&it)) {
+        tfwm_output_t o = {0};
+        o.name = it.data->name;
+        o.geom = (tfwm_geometry_t){
+            it.data->x, it.data->y, it.data->width, it.data->height
+        };
+        if (it.data->primary && n) {
+          (*list)[n] = (*list)[0];
+          (*list)[0] = o;
+        } else {
+          (*list)[n] = o;
+        }
+        n++;
+      }
+      free(r);
+    }
+  }
+
+  if (0 == n) {
+    free(*list);
+    *list = calloc(1, sizeof(tfwm_output_t));
+    if (!*list) {
+      return 0;
+    }
+    (*list)[0].geom = (tfwm_geometry_t){0, 0, core.root_w, core.root_h};
+    n = 1;
+  }
+  return n;
+}
+
+static void tfwm_output_bar(tfwm_output_t *o) {
+  o->bar = xcb_generate_id(core.c);
+  uint32_t bvs[3];
+  bvs[0] = core.cfg->bar_background;
+  bvs[1] = 1;
+  bvs[2] = XCB_EVENT_MASK_EXPOSURE;
+  xcb_create_window(
+      core.c,
+      XCB_COPY_FROM_PARENT,
+      o->bar,
+      core.sc->root,
+      o->geom.x,
+      o->geom.y,
+      o->geom.w,
+      TFWM_BAR_HEIGHT,
+      0,
+      XCB_WINDOW_CLASS_INPUT_OUTPUT,
+      core.sc->root_visual,
+      XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK,
+      bvs
+  );
+  xcb_map_window(core.c, o->bar);
+
+  o->bar_pm = xcb_generate_id(core.c);
+  xcb_create_pixmap(
+      core.c, core.sc->root_depth, o->bar_pm, o->bar, o->geom.w, TFWM_BAR_HEIGHT
+  );
+  tfwm_bar_clear(o, 0, o->geom.w);
+  o->bar_tabs_l = 0;
+  o->bar_tabs_r = o->geom.w;
+}
+
+static void tfwm_output_bar_free(tfwm_output_t *o) {
+  if (o->bar_pm) {
+    xcb_free_pixmap(core.c, o->bar_pm);
+  }
+  if (o->bar) {
+    xcb_destroy_window(core.c, o->bar);
+  }
+  o->bar = 0;
+  o->bar_pm = 0;
+}
+
+static void tfwm_output_init(void) {
+  const xcb_query_extension_reply_t *ext =
+      xcb_get_extension_data(core.c, &xcb_randr_id);
+  if (ext && ext->present) {
+    core.randr = ext->first_event;
+    xcb_discard_reply(core.c, xcb_randr_query_version(core.c, 1, 5).sequence);
+    xcb_randr_select_input(
+        core.c,
+        core.sc->root,
+        XCB_RANDR_NOTIFY_MASK_SCREEN_CHANGE | XCB_RANDR_NOTIFY_MASK_CRTC_CHANGE |
+            XCB_RANDR_NOTIFY_MASK_OUTPUT_CHANGE
+    );
+  }
+
+  core.out_len = tfwm_output_query(&core.out_list);
+  for (uint32_t i = 0; i < core.out_len; i++) {
+    tfwm_output_t *o = &core.out_list[i];
+    o->wsid = i;
+    tfwm_output_bar(o);
+  }
+  for (uint32_t i = 0; i < core.ws_len; i++) {
+    tfwm_workspace_place(i, (i < core.out_len) ? i : 0);
+  }
+  for (uint32_t i = 0; i < core.out_len; i++) {
+    xcb_map_window(core.c, core.ws_list[i].container);
+  }
+  core.cur_out = 0;
+  core.cur_ws = 0;
+  core.prv_ws = 0;
+}
+
+static void tfwm_output_update(void) {
+  core.out_dirty = 0;
+  tfwm_output_t *list;
+  uint32_t n = tfwm_output_query(&list);
+  if (0 == n) {
+    return;
+  }
+
+  uint32_t old_len = core.out_len;
+  uint32_t map[old_len + 1];
+  uint8_t used[core.ws_len];
+  uint8_t moved[n];
+  memset(used, 0, sizeof(used));
+  memset(moved, 0, sizeof(moved));
+  for (uint32_t j = 0; j < old_len; j++) {
+    map[j] = n;
+    tfwm_output_t *old = &core.out_list[j];
+    for (uint32_t i = 0; i < n; i++) {
+      if (list[i].bar || (list[i].name != old->name)) {
+        continue;
+      }
+      tfwm_geometry_t g = list[i].geom;
+      moved[i] = (g.x != old->geom.x) || (g.y != old->geom.y) ||
+                 (g.w != old->geom.w) || (g.h != old->geom.h);
+      list[i] = *old;
+      list[i].geom = g;
+      used[old->wsid] = 1;
+      map[j] = i;
+      break;
+    }
+    if ((n) == map[j]) {
+      xcb_unmap_window(core.c, core.ws_list[old->wsid].container);
+      tfwm_output_bar_free(old);
+    }
+  }
+
+  for (uint32_t i = 0; i < n; i++) {
+    if (list[i].bar) {
+      continue;
+    }
+    uint32_t wsid = 0;
+    while ((wsid < core.ws_len) && used[wsid]) {
+      wsid++;
+    }
+    used[wsid] = 1;
+    list[i].wsid = wsid;
+    tfwm_output_bar(&list[i]);
+    xcb_map_window(core.c, core.ws_list[wsid].container);
+  }
+
+  for (uint32_t i = 0; i < core.ws_len; i++) {
+    tfwm_workspace_t *ws = &core.ws_list[i];
+    ws->out = (ws->out < old_len) && (map[ws->out] < n) ? map[ws->out] : 0;
+  }
+  core.cur_out = (core.cur_out < old_len) && (map[core.cur_out] < n)
+                     ? map[core.cur_out]
+                     : 0;
+  free(core.out_list);
+  core.out_list = list;
+  core.out_len = n;
+
+  for (uint32_t i = 0; i < n; i++) {
+    tfwm_output_t *o = &core.out_list[i];
+    if (moved[i]) {
+      uint32_t vs[3] = {o->geom.x, o->geom.y, o->geom.w};
+      xcb_configure_window(
+          core.c,
+          o->bar,
+          XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH,
+          vs
+      );
+      xcb_free_pixmap(core.c, o->bar_pm);
+      xcb_create_pixmap(
+          core.c, core.sc->root_depth, o->bar_pm, o->bar, o->geom.w, TFWM_BAR_HEIGHT
+      );
+      tfwm_bar_clear(o, 0, o->geom.w);
+      o->bar_tabs_l = 0;
+      o->bar_tabs_r = o->geom.w;
+    }
+    tfwm_workspace_place(o->wsid, i);
+  }
+
+  if ((core.cur_ws) != core.out_list[core.cur_out].wsid) {
+    tfwm_workspace_activate(core.out_list[core.cur_out].wsid);
+  }
+  core.bar_dirty = TFWM_BAR_ALL;
+}
+
+static void tfwm_workspace_window_insert(
+    uint32_t wsid, tfwm_handle_t handle, tfwm_handle_t after
+) {
+  tfwm_workspace_t *ws = &core.ws_list[wsid];
+  tfwm_window_t *w = tfwm_arena_get(handle);
+  if (!w) {
+    return;
+  }
+
+  tfwm_window_t *a = tfwm_arena_get(after);
+  w->wsid = wsid;
+  w->prev = a ? after : 0;
+  w->next = a ? a->next : ws->head;
+  if (w->next) {
+    tfwm_arena_get(w->next)->prev = handle;
+  } else {
+    ws->tail = handle;
+  }
+  if (a) {
+    a->next = handle;
+  } else {
+    ws->head = handle;
+  }
+  ws->win_len++;
+  core.bar_dirty |= TFWM_BAR_TABS;
+  tfwm_journal_workspace(wsid);
+}
+
+static void tfwm_workspace_window_append(uint32_t wsid, tfwm_handle_t handle) {
+  tfwm_workspace_window_insert(wsid, handle, core.ws_list[wsid].tail);
+}
+
+static void tfwm_workspace_window_pop(tfwm_handle_t handle) {
+  tfwm_window_t *w = tfwm_arena_get(handle);
+  if (!w) {
+    return;
+  }
+
+  tfwm_workspace_t *ws = &core.ws_list[w->wsid];
+  if (w->prev) {
+    tfwm_arena_get(w->prev)->next = w->next;
+  } else {
+    ws->head = w->next;
+  }
+  if (w->next) {
+    tfwm_arena_get(w->next)->prev = w->prev;
+  } else {
+    ws->tail = w->prev;
+  }
+  if ((handle) == ws->focus) {
+    ws->focus = 0;
+  }
+  w->prev = 0;
+  w->next = 0;
+  ws->win_len--;
+  core.bar_dirty |= TFWM_BAR_TABS;
+  tfwm_journal_workspace(w->wsid);
+}
+
+static tfwm_geometry_t *tfwm_layout_scratch(uint32_t len) {
+  if (len > core.scratch.cap) {
+    uint32_t cap = core.scratch.cap ? core.scratch.cap : TFWM_ARENA_ALLOC;
+    while (cap < len) {
+      cap *= 2;
+    }
+    tfwm_geometry_t *tmp =
+        realloc(core.scratch.list, cap * sizeof(tfwm_geometry_t));
+    if (!tmp) {
+      return NULL;
+    }
+    core.scratch.list = tmp;
+    core.scratch.cap = cap;
+  }
+
+  return core.scratch.list;
+}
+
+static void tfwm_layout_commit(uint32_t wsid) {
+  tfwm_geometry_t *g = core.scratch.list;
+  tfwm_window_t *w = tfwm_arena_get(core.ws_list[wsid].tail);
+  for (; w; w = tfwm_arena_get(w->prev), g++) {
+    if ((w->x == g->x) && (w->y == g->y) && (w->w == g->w) && (w->h == g->h)) {
+      continue;
+    }
+
+    w->x = g->x;
+    w->y = g->y;
+    w->w = g->w;
+    w->h = g->h;
+    w->is_fullscreen = 0;
+    tfwm_window_configure(w->win, g->x, g->y, g->w, g->h);
+    tfwm_journal_window(w);
+  }
+  tfwm_workspace_restack(wsid);
+}
+
+static void tfwm_layout_apply_tiling(uint32_t wsid) {
+  tfwm_workspace_t *ws = &core.ws_list[wsid];
+  if (0 == ws->win_len) {
+    return;
+  }
+  if (1 == ws->win_len) {
+    tfwm_layout_apply_window(wsid);
+    return;
+  }
+  tfwm_geometry_t *g = tfwm_layout_scratch(ws->win_len);
+  if (!g) {
+    return;
+  }
+
+  int mx = 0;
+  int my = TFWM_BAR_HEIGHT;
+  double master = core.cfg->tile_master;
+  int mw = ((master / 100.0) * ws->geom.w) - (TFWM_BORDER_WIDTH * 2);
+  int mh = ws->geom.h - TFWM_BAR_HEIGHT - (TFWM_BORDER_WIDTH * 2);
+  int sx = mw + (TFWM_BORDER_WIDTH * 2);
+  int sy = my;
+  int sw = ((100.0 - master) / 100.0) * ws->geom.w -
+           (TFWM_BORDER_WIDTH * 2);
+  int sh = mh;
+
+  if (ws->win_len > 2) {
+    sh = ((ws->geom.h - TFWM_BAR_HEIGHT) / (ws->win_len - 1)) -
+         (TFWM_BORDER_WIDTH * 2);
+  }
+
+  g[0] = (tfwm_geometry_t){mx, my, mw, mh};
+  for (uint32_t i = 1; i < ws->win_len; i++) {
+    g[i] = (tfwm_geometry_t){sx, sy, sw, sh};
+    sy += (sh + (TFWM_BORDER_WIDTH * 2));
+  }
+  tfwm_layout_commit(wsid);
+}
+
+static void tfwm_layout_apply_window(uint32_t wsid) {
+  tfwm_workspace_t *ws = &core.ws_list[wsid];
+  if (0 == ws->win_len) {
+    return;
+  }
+  tfwm_geometry_t *g = tfwm_layout_scratch(ws->win_len);
+  if (!g) {
+    return;
+  }
+
+  int x = 0;
+  int y = TFWM_BAR_HEIGHT;
+  int w = ws->geom.w - (TFWM_BORDER_WIDTH * 2);
+  int h = ws->geom.h - TFWM_BAR_HEIGHT - (TFWM_BORDER_WIDTH * 2);
+
+  for (uint32_t i = 0; i < ws->win_len; i++) {
+    g[i] = (tfwm_geometry_t){x, y, w, h};
+  }
+  tfwm_layout_commit(wsid);
+}
+
+static void tfwm_layout_update(uint32_t wsid) {
+  tfwm_workspace_t *ws = &core.ws_list[wsid];
+  uint64_t t = tfwm_trace_begin();
+  if (TFWM_LAYOUT_FLOATING == ws->layout) {
     return;
+  } else if (TFWM_LAYOUT_WINDOW == ws->layout) {
+    tfwm_layout_apply_window(wsid);
+  } else if (TFWM_LAYOUT_TILING == ws->layout) {
+    tfwm_layout_apply_tiling(wsid);
+  }
+  tfwm_trace_end(TFWM_TRACE_LAYOUT, wsid, t, ws->container);
+}
+
+static pid_t tfwm_launch(char **cmd) {
+  core.launch.last = -1;
+  if (!cmd || !cmd[0]) {
+    return -1;
   }
 
-  xcb_set_input_focus(
-      core.c, XCB_INPUT_FOCUS_POINTER_ROOT, window, XCB_CURRENT_TIME
+  if (core.launch.len == core.launch.cap) {
+    uint32_t cap = core.launch.cap ? core.launch.cap * 2 : TFWM_LAUNCH_ALLOC;
+    tfwm_launch_t *list = realloc(core.launch.list, cap * sizeof(tfwm_launch_t));
+    if (!list) {
+      return -1;
+    }
+    core.launch.list = list;
+    core.launch.cap = cap;
+  }
+
+  posix_spawnattr_t attr;
+  sigset_t set;
+  posix_spawnattr_init(&attr);
+  sigemptyset(&set);
+  posix_spawnattr_setsigmask(&attr, &set);
+  sigaddset(&set, SIGCHLD);
+  sigaddset(&set, SIGTERM);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGUSR1);
+  posix_spawnattr_setsigdefault(&attr, &set);
+  posix_spawnattr_setpgroup(&attr, 0);
+  posix_spawnattr_setflags(
+      &attr,
+      POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP
   );
-  if ((window) == core.sc->root) {
-    core.win = window;
-    core.cur_win = 0;
-  } else {
-    tfwm_workspace_t *ws = &core.ws_list[core.cur_ws];
-    for (uint32_t i = 0; i < ws->win_len; i++) {
-      if (ws->win_list[i].win == window) {
-        core.win = window;
-        core.cur_win = i;
-        break;
-      }
+
+  pid_t pid;
+  int err = posix_spawnp(&pid, cmd[0], NULL, &attr, cmd, environ);
+  posix_spawnattr_destroy(&attr);
+  if (err != 0) {
+    TFWM_LOG(TFWM_LOG_ERROR, TFWM_SYS_LAUNCH, "can not spawn %s", cmd[0]);
+    return -1;
+  }
+
+  core.launch.list[core.launch.len++] =
+      (tfwm_launch_t){pid, core.cur_ws, tfwm_stats_now()};
+  core.launch.last = pid;
+  return pid;
+}
+
+static int tfwm_launch_take(pid_t pid, uint32_t *wsid) {
+  for (uint32_t i = 0; i < core.launch.len; i++) {
+    if ((pid) != core.launch.list[i].pid) {
+      continue;
     }
 
-    uint32_t vs[1] = {XCB_STACK_MODE_ABOVE};
-    xcb_configure_window(core.c, core.win, XCB_CONFIG_WINDOW_STACK_MODE, vs);
+    *wsid = core.launch.list[i].wsid;
+    core.stats.launch++;
+    tfwm_stats_latency(
+        core.stats.launch_hist, tfwm_stats_now() - core.launch.list[i].t
+    );
+    core.launch.list[i] = core.launch.list[--core.launch.len];
+    return 1;
   }
-  xcb_clear_area(core.c, 1, core.bar, 0, 0, 0, 0);
+
+  return 0;
 }
 
-static void tfwm_window_color(xcb_window_t window, uint32_t color) {
-  if (TFWM_BORDER_WIDTH <= 0) {
+static void tfwm_launch_reap(pid_t pid) {
+  for (uint32_t i = 0; i < core.launch.len; i++) {
+    if ((pid) == core.launch.list[i].pid) {
+      core.launch.list[i] = core.launch.list[--core.launch.len];
+      return;
+    }
+  }
+}
+
+static void tfwm_drag_apply(void) {
+  if (0 == core.drag.pending) {
     return;
   }
-  if (0 == window) {
+  core.drag.pending = 0;
+  if (TFWM_LAYOUT_FLOATING != core.ws_list[core.cur_ws].layout) {
     return;
   }
-  if ((window) == core.sc->root) {
+
+  int dx = core.drag.ptr_x - core.ptr_x;
+  int dy = core.drag.ptr_y - core.ptr_y;
+  if ((0 == dx) && (0 == dy)) {
+    return;
+  }
+  core.ptr_x = core.drag.ptr_x;
+  core.ptr_y = core.drag.ptr_y;
+  tfwm_window_t *w = tfwm_arena_get(tfwm_index_get(core.drag.win));
+  if (!w) {
     return;
   }
 
-  uint32_t vs[1] = {color};
-  xcb_change_window_attributes(core.c, window, XCB_CW_BORDER_PIXEL, vs);
+  uint32_t vs[2];
+  if ((uint32_t)(BTN_LEFT) == core.cur_btn) {
+    core.drag.x += dx;
+    core.drag.y += dy;
+    vs[0] = core.drag.x;
+    vs[1] = core.drag.y;
+    w->x = core.drag.x;
+    w->y = core.drag.y;
+    xcb_configure_window(
+        core.c, w->frame, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, vs
+    );
+  } else if ((uint32_t)(BTN_RIGHT) == core.cur_btn) {
+    core.drag.w = MAX(core.drag.w + dx, (int)TFWM_MIN_WINDOW_WIDTH);
+    core.drag.h = MAX(core.drag.h + dy, (int)TFWM_MIN_WINDOW_HEIGHT);
+    vs[0] = core.drag.w;
+    vs[1] = core.drag.h;
+    w->w = w->cw = core.drag.w;
+    w->h = w->ch = core.drag.h;
+    uint32_t mask = XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT;
+    xcb_configure_window(core.c, w->frame, mask, vs);
+    xcb_configure_window(core.c, w->win, mask, vs);
+  }
 }
 
-static void tfwm_window_move(xcb_window_t window, int x, int y) {
-  uint32_t vs[2] = {x, y};
-  xcb_configure_window(
-      core.c, window, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, vs
+static tfwm_pending_t *tfwm_map_begin(xcb_window_t window) {
+  if (tfwm_index_get(window)) {
+    xcb_map_window(core.c, window);
+    return NULL;
+  }
+  for (uint32_t i = 0; i < core.pending.len; i++) {
+    if (core.pending.list[i].win == window) {
+      return NULL;
+    }
+  }
+
+  if (core.pending.len == core.pending.cap) {
+    uint32_t cap = core.pending.cap ? core.pending.cap * 2 : TFWM_PENDING_ALLOC;
+    tfwm_pending_t *tmp =
+        realloc(core.pending.list, cap * sizeof(tfwm_pending_t));
+    if (!tmp) {
+      return NULL;
+    }
+    core.pending.list = tmp;
+    core.pending.cap = cap;
+  }
+
+  tfwm_pending_t *p = &core.pending.list[core.pending.len++];
+  *p = (tfwm_pending_t){0};
+  p->win = window;
+  core.stats.rt[TFWM_STAT_RT_MAP_REQUEST]++;
+  p->ck[TFWM_PROP_CLASS] = xcb_get_property(
+      core.c, 0, window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 250
+  );
+  p->ck[TFWM_PROP_NAME] = xcb_get_property(
+      core.c, 0, window, XCB_ATOM_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, 0, 250
+  );
+  p->ck[TFWM_PROP_NORMAL_HINTS] = xcb_get_property(
+      core.c, 0, window, XCB_ATOM_WM_NORMAL_HINTS, XCB_ATOM_WM_SIZE_HINTS, 0, 18
+  );
+  p->ck[TFWM_PROP_WINDOW_TYPE] = xcb_get_property(
+      core.c,
+      0,
+      window,
+      core.atom[TFWM_ATOM_NET_WM_WINDOW_TYPE],
+      XCB_ATOM_ATOM,
+      0,
+      32
+  );
+  p->ck[TFWM_PROP_TRANSIENT_FOR] = xcb_get_property(
+      core.c, 0, window, XCB_ATOM_WM_TRANSIENT_FOR, XCB_ATOM_WINDOW, 0, 1
   );
+  p->ck[TFWM_PROP_PID] = xcb_get_property(
+      core.c, 0, window, core.atom[TFWM_ATOM_NET_WM_PID], XCB_ATOM_CARDINAL, 0, 1
+  );
+  return p;
 }
 
-static void tfwm_window_resize(xcb_window_t window, int w, int h) {
-  if ((w < TFWM_MIN_WINDOW_WIDTH) || (h < TFWM_MIN_WINDOW_HEIGHT)) {
-    return;
+static void tfwm_map_cancel(xcb_window_t window) {
+  for (uint32_t i = 0; i < core.pending.len; i++) {
+    if (core.pending.list[i].win == window) {
+      core.pending.list[i].win = 0;
+    }
   }
+}
 
-  uint32_t vs[2] = {w, h};
-  xcb_configure_window(
-      core.c, window, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, vs
-  );
+static int tfwm_map_poll(tfwm_pending_t *p) {
+  for (int i = 0; i < TFWM_PROP_LEN; i++) {
+    if (p->done & (1 << i)) {
+      continue;
+    }
+
+    xcb_generic_error_t *err = NULL;
+    if (!xcb_poll_for_reply(core.c, p->ck[i].sequence, (void **)&p->r[i], &err)) {
+      return 0;
+    }
+    free(err);
+    p->done |= (1 << i);
+  }
+  if (!p->adopt) {
+    return 1;
+  }
+
+  xcb_generic_error_t *err = NULL;
+  if (!(p->done & (1 << TFWM_PROP_LEN))) {
+    if (!xcb_poll_for_reply(core.c, p->attr_ck.sequence, (void **)&p->attr, &err)) {
+      return 0;
+    }
+    free(err);
+    p->done |= (1 << TFWM_PROP_LEN);
+  }
+  err = NULL;
+  if (!xcb_poll_for_reply(core.c, p->geom_ck.sequence, (void **)&p->geom, &err)) {
+    return 0;
+  }
+  free(err);
+  return 1;
 }
 
-static void tfwm_window_set_attr(xcb_window_t window, int x, int y, int w, int h) {
-  if (0 == core.cur_win) {
+static void tfwm_map_finish(tfwm_pending_t *p) {
+  xcb_get_property_reply_t **r = p->r;
+  if (0 == p->win) {
     return;
   }
-  if ((core.win) == core.sc->root) {
+  if (p->adopt && (!p->attr || p->attr->override_redirect ||
+                   (XCB_MAP_STATE_VIEWABLE != p->attr->map_state))) {
+    if (p->slot) {
+      core.journal.map->list[p->slot - 1].win = 0;
+    }
     return;
   }
 
-  tfwm_window_t *win = &core.ws_list[core.cur_ws].win_list[core.cur_win];
-  win->x = x;
-  win->y = y;
+  if (r[TFWM_PROP_WINDOW_TYPE]) {
+    xcb_atom_t *t = xcb_get_property_value(r[TFWM_PROP_WINDOW_TYPE]);
+    int n = xcb_get_property_value_length(r[TFWM_PROP_WINDOW_TYPE]) / 4;
+    for (int i = 0; i < n; i++) {
+      if (t[i] == core.atom[TFWM_ATOM_NET_WM_WINDOW_TYPE_DOCK]) {
+        xcb_map_window(core.c, p->win);
+        return;
+      }
+    }
+  }
+
+  int w = TFWM_WINDOW_WIDTH;
+  int h = TFWM_WINDOW_HEIGHT;
+  if (r[TFWM_PROP_NORMAL_HINTS] &&
+      (xcb_get_property_value_length(r[TFWM_PROP_NORMAL_HINTS]) >= 7 * 4)) {
+    uint32_t *sh = xcb_get_property_value(r[TFWM_PROP_NORMAL_HINTS]);
+    if ((sh[0] & (TFWM_SIZE_HINT_US_SIZE | TFWM_SIZE_HINT_P_SIZE)) && sh[3] &&
+        sh[4]) {
+      w = sh[3];
+      h = sh[4];
+    }
+    if (sh[0] & TFWM_SIZE_HINT_P_MIN_SIZE) {
+      w = MAX(w, (int)sh[5]);
+      h = MAX(h, (int)sh[6]);
+    }
+  }
+
+  uint32_t wsid = core.cur_ws;
+  if (r[TFWM_PROP_PID] && (xcb_get_property_value_length(r[TFWM_PROP_PID]) >= 4)) {
+    uint32_t *pid = xcb_get_property_value(r[TFWM_PROP_PID]);
+    tfwm_launch_take(*pid, &wsid);
+  }
+  if (p->geom) {
+    w = p->geom->width;
+    h = p->geom->height;
+    wsid = tfwm_adopt_workspace(p->geom->x, p->geom->y);
+  }
+
+  int cx = core.ws_list[wsid].geom.w / 2;
+  int cy = core.ws_list[wsid].geom.h / 2;
+  if (r[TFWM_PROP_TRANSIENT_FOR] &&
+      (xcb_get_property_value_length(r[TFWM_PROP_TRANSIENT_FOR]) >= 4)) {
+    xcb_window_t *t = xcb_get_property_value(r[TFWM_PROP_TRANSIENT_FOR]);
+    tfwm_window_t *parent = tfwm_arena_get(tfwm_index_get(*t));
+    if (parent) {
+      cx = parent->x + (parent->w / 2);
+      cy = parent->y + (parent->h / 2);
+    }
+  }
+
+  tfwm_handle_t hd = tfwm_arena_alloc();
+  tfwm_window_t *win = tfwm_arena_get(hd);
+  if (!win) {
+    return;
+  }
+  win->x = cx - (w / 2);
+  win->y = cy - (h / 2);
   win->w = w;
   win->h = h;
+  win->b = TFWM_BORDER_WIDTH;
+  win->cw = w;
+  win->ch = h;
+  if (p->slot) {
+    tfwm_journal_entry_t *j = &core.journal.map->list[p->slot - 1];
+    wsid = (j->wsid < core.ws_len) ? j->wsid : wsid;
+    win->x = j->x;
+    win->y = j->y;
+    win->w = j->w;
+    win->h = j->h;
+    win->cw = j->cw;
+    win->ch = j->ch;
+    win->slot = p->slot;
+  } else if (p->geom) {
+    win->x = p->geom->x - core.ws_list[wsid].geom.x;
+    win->y = p->geom->y - core.ws_list[wsid].geom.y;
+  }
+  win->win = p->win;
+  win->frame = xcb_generate_id(core.c);
+  win->class = tfwm_util_prop_string(r[TFWM_PROP_CLASS], 1);
+  if (!win->class) {
+    win->class = tfwm_util_prop_string(r[TFWM_PROP_NAME], 0);
+  }
+  if (!win->class) {
+    win->class = calloc(1, sizeof(char));
+  }
+
+  uint32_t fvs[3] = {
+      core.cfg->frame_background,
+      core.cfg->border_inactive,
+      XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY
+  };
+  xcb_create_window(
+      core.c,
+      XCB_COPY_FROM_PARENT,
+      win->frame,
+      core.ws_list[wsid].container,
+      win->x,
+      win->y,
+      win->w,
+      win->h,
+      win->b,
+      XCB_WINDOW_CLASS_INPUT_OUTPUT,
+      core.sc->root_visual,
+      XCB_CW_BACK_PIXEL | XCB_CW_BORDER_PIXEL | XCB_CW_EVENT_MASK,
+      fvs
+  );
+  if ((0 == p->slot) || (win->cw != win->w) || (win->ch != win->h)) {
+    win->cw = win->w;
+    win->ch = win->h;
+    uint32_t vs[3] = {win->w, win->h, 0};
+    xcb_configure_window(
+        core.c,
+        p->win,
+        XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT |
+            XCB_CONFIG_WINDOW_BORDER_WIDTH,
+        vs
+    );
+  }
+  uint32_t atvs[1] = {XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_FOCUS_CHANGE};
+  xcb_change_window_attributes(core.c, p->win, XCB_CW_EVENT_MASK, atvs);
+  xcb_change_save_set(core.c, XCB_SET_MODE_INSERT, p->win);
+  xcb_reparent_window(core.c, p->win, win->frame, 0, 0);
+  xcb_map_window(core.c, p->win);
+
+  TFWM_LOG(
+      TFWM_LOG_DEBUG,
+      TFWM_SYS_WINDOW,
+      "manage 0x%x on %s",
+      p->win,
+      core.ws_list[wsid].name
+  );
+  tfwm_index_put(p->win, hd);
+  tfwm_index_put(win->frame, hd);
+  tfwm_workspace_window_append(wsid, hd);
+  if (!p->adopt) {
+    tfwm_layout_update(wsid);
+  }
+  xcb_map_window(core.c, win->frame);
+  if (p->adopt || (wsid != core.cur_ws)) {
+    return;
+  }
+  tfwm_window_focus(p->win);
 }
 
-static void tfwm_workspace_window_unmap(uint32_t wsid) {
-  tfwm_workspace_t *ws = &core.ws_list[wsid];
-  for (uint32_t i = 0; i < ws->win_len; i++) {
-    xcb_unmap_window(core.c, ws->win_list[i].win);
-    tfwm_window_color(ws->win_list[i].win, TFWM_BORDER_INACTIVE);
+static void tfwm_map_complete(void) {
+  uint32_t n = 0;
+  while ((n < core.pending.len) && tfwm_map_poll(&core.pending.list[n])) {
+    tfwm_pending_t *p = &core.pending.list[n];
+    tfwm_map_finish(p);
+    for (int i = 0; i < TFWM_PROP_LEN; i++) {
+      free(p->r[i]);
+    }
+    free(p->attr);
+    free(p->geom);
+    if (p->adopt && (0 == --core.pending.adopt)) {
+      tfwm_adopt_settle();
+    }
+    n++;
   }
+  if (0 == n) {
+    return;
+  }
+
+  core.pending.len -= n;
+  memmove(
+      core.pending.list,
+      core.pending.list + n,
+      core.pending.len * sizeof(tfwm_pending_t)
+  );
 }
 
-static void tfwm_workspace_window_map(uint32_t wsid) {
-  tfwm_workspace_t *ws = &core.ws_list[wsid];
-  if (0 == ws->win_len) {
-    tfwm_window_focus(core.sc->root);
+static void tfwm_adopt_scan(
+    xcb_query_tree_cookie_t tck, xcb_get_property_cookie_t sck
+) {
+  uint64_t t = tfwm_stats_roundtrip(TFWM_STAT_RT_ADOPT);
+  tfwm_journal_session(xcb_get_property_reply(core.c, sck, NULL));
+
+  xcb_query_tree_reply_t *r = xcb_query_tree_reply(core.c, tck, NULL);
+  tfwm_trace_end(TFWM_TRACE_WAIT, TFWM_STAT_RT_ADOPT, t, 0);
+  if (r) {
+    int n = xcb_query_tree_children_length(r);
+    xcb_window_t *children = xcb_query_tree_children(r);
+    uint32_t order[TFWM_JOURNAL_WINDOWS];
+    uint32_t len = tfwm_journal_order(children, n, order);
+    for (uint32_t i = 0; i < len; i++) {
+      tfwm_adopt_begin(core.journal.map->list[order[i]].win, order[i] + 1);
+    }
+    for (int i = 0; i < n; i++) {
+      tfwm_adopt_begin(children[i], 0);
+    }
+    free(r);
+  }
+  if (0 == core.pending.adopt) {
+    tfwm_adopt_settle();
+  }
+}
+
+static void tfwm_adopt_begin(xcb_window_t window, uint32_t slot) {
+  tfwm_pending_t *p = tfwm_map_begin(window);
+  if (!p) {
     return;
   }
 
-  for (uint32_t i = 0; i < ws->win_len; i++) {
-    xcb_map_window(core.c, ws->win_list[i].win);
-    if (i == (ws->win_len - 1)) {
-      tfwm_window_focus(ws->win_list[i].win);
-    } else {
-      tfwm_window_color(ws->win_list[i].win, TFWM_BORDER_INACTIVE);
+  p->adopt = 1;
+  p->slot = slot;
+  p->attr_ck = xcb_get_window_attributes(core.c, window);
+  p->geom_ck = xcb_get_geometry(core.c, window);
+  core.pending.adopt++;
+}
+
+static uint32_t tfwm_adopt_workspace(int x, int y) {
+  for (uint32_t i = 0; i < core.out_len; i++) {
+    tfwm_geometry_t *g = &core.out_list[i].geom;
+    if ((x >= g->x) && (x < g->x + g->w) && (y >= g->y) && (y < g->y + g->h)) {
+      return core.out_list[i].wsid;
     }
   }
+  return core.cur_ws;
 }
 
-static void tfwm_workspace_window_malloc(uint32_t wsid) {
-  tfwm_workspace_t *ws = &core.ws_list[wsid];
-  if (ws->win_list) {
+static void tfwm_adopt_settle(void) {
+  for (uint32_t i = 0; i < core.ws_len; i++) {
+    tfwm_layout_update(i);
+  }
+  uint32_t wsid = core.journal.map ? core.journal.map->cur_ws : core.cur_ws;
+  tfwm_workspace_activate((wsid < core.ws_len) ? wsid : core.cur_ws);
+  if (0 == core.stats.start) {
     return;
   }
 
-  ws->win_list =
-      (tfwm_window_t *)malloc(TFWM_WIN_LIST_ALLOC * sizeof(tfwm_window_t));
-  ws->win_cap = TFWM_WIN_LIST_ALLOC;
+  unsigned long long rt = 0;
+  for (int i = 0; i < TFWM_STAT_RT_LEN; i++) {
+    rt += core.stats.rt[i];
+  }
+  TFWM_LOG(
+      TFWM_LOG_INFO,
+      TFWM_SYS_CORE,
+      "started in %lluus, %llu round trips, %u windows",
+      (unsigned long long)(tfwm_stats_now() - core.stats.start),
+      rt,
+      core.arena.len
+  );
+  core.stats.start = 0;
 }
 
-static void tfwm_workspace_window_realloc(uint32_t wsid) {
-  tfwm_workspace_t *ws = &core.ws_list[wsid];
-  if (!ws->win_list) {
+void tfwm_handle_keypress(xcb_generic_event_t *event) {
+  xcb_key_press_event_t *e = (xcb_key_press_event_t *)event;
+  uint16_t i = core.kbd.bind[e->detail][tfwm_keyboard_clean_mask(e->state)];
+  if (0 == i) {
     return;
   }
 
-  tfwm_window_t *tmp = (tfwm_window_t *)realloc(
-      ws->win_list, (ws->win_cap + TFWM_WIN_LIST_ALLOC) * sizeof(tfwm_window_t)
-  );
-  if (!tmp) {
+  core.cfg->keys[i - 1].func((char **)core.cfg->keys[i - 1].cmd);
+}
+
+void tfwm_handle_map_request(xcb_generic_event_t *event) {
+  xcb_map_request_event_t *e = (xcb_map_request_event_t *)event;
+  tfwm_map_begin(e->window);
+}
+
+void tfwm_handle_focus_in(xcb_generic_event_t *event) {
+  xcb_focus_in_event_t *e = (xcb_focus_in_event_t *)event;
+  tfwm_window_color(e->event, core.cfg->border_active);
+}
+
+void tfwm_handle_focus_out(xcb_generic_event_t *event) {
+  xcb_focus_out_event_t *e = (xcb_focus_out_event_t *)event;
+  tfwm_window_color(e->event, core.cfg->border_inactive);
+}
+
+void tfwm_handle_enter_notify(xcb_generic_event_t *event) {
+  xcb_enter_notify_event_t *e = (xcb_enter_notify_event_t *)event;
+}
+
+void tfwm_handle_leave_notify(xcb_generic_event_t *event) {
+  xcb_leave_notify_event_t *e = (xcb_leave_notify_event_t *)event;
+}
+
+void tfwm_handle_motion_notify(xcb_generic_event_t *event) {
+  if (0 == core.drag.win) {
     return;
   }
 
-  ws->win_list = tmp;
-  ws->win_cap += TFWM_WIN_LIST_ALLOC;
+  xcb_motion_notify_event_t *e = (xcb_motion_notify_event_t *)event;
+  core.drag.ptr_x = e->root_x;
+  core.drag.ptr_y = e->root_y;
+  core.drag.pending = 1;
 }
 
-static void tfwm_workspace_window_append(uint32_t wsid, tfwm_window_t window) {
-  tfwm_workspace_t *ws = &core.ws_list[wsid];
-  if (!ws->win_list) {
-    tfwm_workspace_window_malloc(wsid);
-  } else if (ws->win_cap == core.ws_list[wsid].win_len) {
-    tfwm_workspace_window_realloc(wsid);
+void tfwm_handle_destroy_notify(xcb_generic_event_t *event) {
+  xcb_destroy_notify_event_t *e = (xcb_destroy_notify_event_t *)event;
+  tfwm_map_cancel(e->window);
+  tfwm_window_unmanage(e->window);
+}
+
+void tfwm_handle_unmap_notify(xcb_generic_event_t *event) {
+  xcb_unmap_notify_event_t *e = (xcb_unmap_notify_event_t *)event;
+  tfwm_window_t *w = tfwm_arena_get(tfwm_index_get(e->window));
+  if (!w) {
+    return;
   }
 
-  ws->win_list[ws->win_len++] = window;
+  if (((e->window) == w->frame) || ((e->event) != w->frame)) {
+    return;
+  }
+
+  xcb_change_save_set(core.c, XCB_SET_MODE_DELETE, w->win);
+  tfwm_geometry_t *g = &core.ws_list[w->wsid].geom;
+  xcb_reparent_window(core.c, w->win, core.sc->root, g->x + w->x, g->y + w->y);
+  tfwm_window_unmanage(e->window);
 }
 
-static void tfwm_workspace_window_pop(uint32_t wid) {
-  tfwm_workspace_t *ws = &core.ws_list[core.cur_ws];
-  if (wid < ws->win_len - 1) {
-    for (uint32_t i = wid + 1; i < ws->win_len; i++) {
-      ws->win_list[i - 1] = ws->win_list[i];
+void tfwm_handle_button_press(xcb_generic_event_t *event) {
+  xcb_button_press_event_t *e = (xcb_button_press_event_t *)event;
+  tfwm_window_t *w = tfwm_arena_get(tfwm_index_get(e->child));
+  core.win = w ? w->win : e->child;
+  core.ptr_x = e->root_x;
+  core.ptr_y = e->root_y;
+  tfwm_window_focus(core.win);
+
+  core.cur_btn =
+      ((e->detail == BTN_LEFT) ? BTN_LEFT : ((core.win != 0) ? BTN_RIGHT : 0));
+  core.drag = (tfwm_drag_t){0};
+  if (w) {
+    core.drag.win = core.win;
+    core.drag.x = w->x;
+    core.drag.y = w->y;
+    core.drag.w = w->w;
+    core.drag.h = w->h;
+    core.drag.ptr_x = core.ptr_x;
+    core.drag.ptr_y = core.ptr_y;
+  }
+
+  xcb_cursor_t csr = XCB_NONE;
+  if ((uint32_t)BTN_LEFT == core.cur_btn) {
+    csr = core.cursor[TFWM_CSR_MOVE];
+  } else if ((uint32_t)BTN_RIGHT == core.cur_btn) {
+    csr = core.cursor[TFWM_CSR_RESIZE];
+  }
+  xcb_grab_pointer(
+      core.c,
+      0,
+      core.sc->root,
+      XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_BUTTON_MOTION,
+      XCB_GRAB_MODE_ASYNC,
+      XCB_GRAB_MODE_ASYNC,
+      core.sc->root,
+      csr,
+      XCB_CURRENT_TIME
+  );
+}
+
+void tfwm_handle_button_release(xcb_generic_event_t *event) {
+  xcb_ungrab_pointer(core.c, XCB_CURRENT_TIME);
+  if (0 == core.drag.win) {
+    return;
+  }
+  if (TFWM_LAYOUT_FLOATING != core.ws_list[core.cur_ws].layout) {
+    core.drag.win = 0;
+    return;
+  }
+
+  tfwm_drag_apply();
+  tfwm_window_configure(
+      core.drag.win, core.drag.x, core.drag.y, core.drag.w, core.drag.h
+  );
+  tfwm_window_set_attr(
+      core.drag.win, core.drag.x, core.drag.y, core.drag.w, core.drag.h
+  );
+  core.drag.win = 0;
+}
+
+void tfwm_handle_expose(xcb_generic_event_t *event) {
+  xcb_expose_event_t *e = (xcb_expose_event_t *)event;
+  for (uint32_t i = 0; i < core.out_len; i++) {
+    tfwm_output_t *o = &core.out_list[i];
+    if ((e->window) != o->bar) {
+      continue;
     }
+
+    xcb_copy_area(
+        core.c,
+        o->bar_pm,
+        o->bar,
+        core.gc_inactive,
+        e->x,
+        e->y,
+        e->x,
+        e->y,
+        e->width,
+        e->height
+    );
+    return;
   }
-  ws->win_len--;
 }
 
-static void tfwm_layout_apply_tiling(uint32_t wsid) {
-  tfwm_workspace_t *ws = &core.ws_list[wsid];
-  if (0 == ws->win_len) {
+void tfwm_handle_property_notify(xcb_generic_event_t *event) {
+  xcb_property_notify_event_t *e = (xcb_property_notify_event_t *)event;
+  if ((e->window) != core.sc->root) {
     return;
   }
-  if (1 == ws->win_len) {
-    tfwm_layout_apply_window(wsid);
+  if (e->atom != core.atom[TFWM_ATOM_TFWM_STATS_REQUEST]) {
+    return;
+  }
+  if (XCB_PROPERTY_NEW_VALUE != e->state) {
     return;
   }
 
-  int mx = 0;
-  int my = TFWM_BAR_HEIGHT;
-  int mw = ((TFWM_TILE_MASTER / 100.0) * core.sc->width_in_pixels) -
-           (TFWM_BORDER_WIDTH * 2);
-  int mh = core.sc->height_in_pixels - TFWM_BAR_HEIGHT - (TFWM_BORDER_WIDTH * 2);
-  int sx = mw + (TFWM_BORDER_WIDTH * 2);
-  int sy = my;
-  int sw = ((100.0 - TFWM_TILE_MASTER) / 100.0) * core.sc->width_in_pixels -
-           (TFWM_BORDER_WIDTH * 2);
-  int sh = mh;
+  tfwm_stats_dump();
+}
 
-  if (ws->win_len > 2) {
-    sh = ((core.sc->height_in_pixels - TFWM_BAR_HEIGHT) / (ws->win_len - 1)) -
-         (TFWM_BORDER_WIDTH * 2);
+void tfwm_handle_screen_change(xcb_generic_event_t *event) {
+  uint8_t e = event->response_type & ~0x80;
+  if ((core.randr + XCB_RANDR_SCREEN_CHANGE_NOTIFY) == e) {
+    xcb_randr_screen_change_notify_event_t *sc =
+        (xcb_randr_screen_change_notify_event_t *)event;
+    core.root_w = sc->width;
+    core.root_h = sc->height;
+  }
+  core.out_dirty = 1;
+}
+
+void tfwm_handle_mapping_notify(xcb_generic_event_t *event) {
+  xcb_mapping_notify_event_t *e = (xcb_mapping_notify_event_t *)event;
+  if (XCB_MAPPING_POINTER == e->request) {
+    return;
   }
-  int last = core.ws_list[wsid].win_len - 1;
 
-  for (int i = last; i >= 0; i--) {
-    if (i == last) {
-      ws->win_list[i].x = mx;
-      ws->win_list[i].y = my;
-      ws->win_list[i].w = mw;
-      ws->win_list[i].h = mh;
-      tfwm_window_move(ws->win_list[i].win, mx, my);
-      tfwm_window_resize(ws->win_list[i].win, mw, mh);
-    } else {
-      ws->win_list[i].x = sx;
-      ws->win_list[i].y = sy;
-      ws->win_list[i].w = sw;
-      ws->win_list[i].h = sh;
-      tfwm_window_move(ws->win_list[i].win, sx, sy);
-      tfwm_window_resize(ws->win_list[i].win, sw, sh);
-      sy += (sh + (TFWM_BORDER_WIDTH * 2));
+  xcb_refresh_keyboard_mapping(core.kbd.syms, e);
+  tfwm_keyboard_load(xcb_get_modifier_mapping(core.c));
+}
+
+static void tfwm_loop_init(void) {
+  core.loop.fd = epoll_create1(EPOLL_CLOEXEC);
+  if (core.loop.fd < 0) {
+    TFWM_LOG(TFWM_LOG_ERROR, TFWM_SYS_LOOP, "can not create event loop");
+    core.exit = EXIT_FAILURE;
+    return;
+  }
+  tfwm_loop_add(xcb_get_file_descriptor(core.c), EPOLLIN, NULL);
+
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGCHLD);
+  sigaddset(&set, SIGTERM);
+  sigaddset(&set, SIGINT);
+  sigaddset(&set, SIGUSR1);
+  sigprocmask(SIG_BLOCK, &set, NULL);
+  core.loop.sig = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (core.loop.sig < 0) {
+    TFWM_LOG(TFWM_LOG_ERROR, TFWM_SYS_LOOP, "can not create signalfd");
+    core.exit = EXIT_FAILURE;
+    return;
+  }
+  tfwm_loop_add(core.loop.sig, EPOLLIN, tfwm_loop_signal);
+}
+
+static int tfwm_loop_add(int fd, uint32_t events, void (*func)(int, uint32_t)) {
+  uint32_t i = 0;
+  while ((i < core.loop.len) && (core.loop.list[i].fd >= 0)) {
+    i++;
+  }
+  if (i == core.loop.len) {
+    if (core.loop.len == core.loop.cap) {
+      uint32_t cap = core.loop.cap ? core.loop.cap * 2 : TFWM_LOOP_ALLOC;
+      tfwm_source_t *list = realloc(core.loop.list, cap * sizeof(tfwm_source_t));
+      if (!list) {
+        return -1;
+      }
+      core.loop.list = list;
+      core.loop.cap = cap;
+    }
+    core.loop.len++;
+  }
+
+  struct epoll_event ev = {.events = events, .data.u32 = i};
+  if (epoll_ctl(core.loop.fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    core.loop.list[i] = (tfwm_source_t){-1, NULL};
+    return -1;
+  }
+  core.loop.list[i] = (tfwm_source_t){fd, func};
+  return 0;
+}
+
+static void tfwm_loop_del(int fd) {
+  for (uint32_t i = 0; i < core.loop.len; i++) {
+    if ((fd) == core.loop.list[i].fd) {
+      epoll_ctl(core.loop.fd, EPOLL_CTL_DEL, fd, NULL);
+      core.loop.list[i] = (tfwm_source_t){-1, NULL};
+      return;
     }
   }
 }
 
-static void tfwm_layout_apply_window(uint32_t wsid) {
-  tfwm_workspace_t *ws = &core.ws_list[wsid];
-  if (0 == ws->win_len) {
-    return;
+static int tfwm_loop_timer(uint32_t ms, void (*func)(int, uint32_t)) {
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0) {
+    return -1;
   }
 
-  int x = 0;
-  int y = TFWM_BAR_HEIGHT;
-  int w = core.sc->width_in_pixels - (TFWM_BORDER_WIDTH * 2);
-  int h = core.sc->height_in_pixels - TFWM_BAR_HEIGHT - (TFWM_BORDER_WIDTH * 2);
-  int last = ws->win_len - 1;
-
-  for (int i = last; i >= 0; i--) {
-    ws->win_list[i].x = x;
-    ws->win_list[i].y = y;
-    ws->win_list[i].w = w;
-    ws->win_list[i].h = h;
-    tfwm_window_move(ws->win_list[i].win, x, y);
-    tfwm_window_resize(ws->win_list[i].win, w, h);
+  struct timespec ts = {ms / 1000, (ms % 1000) * 1000000};
+  struct itimerspec it = {ts, ts};
+  if ((timerfd_settime(fd, 0, &it, NULL) < 0) ||
+      (tfwm_loop_add(fd, EPOLLIN, func) < 0)) {
+    close(fd);
+    return -1;
   }
+  return fd;
 }
 
-static void tfwm_layout_update(uint32_t wsid) {
-  tfwm_workspace_t *ws = &core.ws_list[wsid];
-  if (TFWM_LAYOUT_FLOATING == ws->layout) {
-    return;
-  } else if (TFWM_LAYOUT_WINDOW == ws->layout) {
-    tfwm_layout_apply_window(wsid);
-  } else if (TFWM_LAYOUT_TILING == ws->layout) {
-    tfwm_layout_apply_tiling(wsid);
+static void tfwm_loop_signal(int fd, uint32_t events) {
+  struct signalfd_siginfo si;
+  while (read(fd, &si, sizeof(si)) == sizeof(si)) {
+    if (SIGCHLD == si.ssi_signo) {
+      pid_t pid;
+      while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        tfwm_launch_reap(pid);
+      }
+    } else if (SIGUSR1 == si.ssi_signo) {
+      core.stats.dump = 1;
+    } else {
+      core.quit = 1;
+    }
   }
 }
 
-void tfwm_handle_keypress(xcb_generic_event_t *event) {
-  xcb_key_press_event_t *e = (xcb_key_press_event_t *)event;
-  xcb_keysym_t keysym = tfwm_util_keysym(e->detail);
+static void tfwm_loop_cleanup(void) {
+  if (core.loop.clock >= 0) {
+    close(core.loop.clock);
+  }
+  if (core.loop.sig >= 0) {
+    close(core.loop.sig);
+  }
+  if (core.loop.fd >= 0) {
+    close(core.loop.fd);
+  }
+  if (core.loop.list) {
+    free(core.loop.list);
+  }
+}
 
-  for (int i = 0; i < ARRAY_LENGTH(cfg_keybinds); i++) {
-    if ((cfg_keybinds[i].keysym == keysym) && (cfg_keybinds[i].mod == e->state)) {
-      cfg_keybinds[i].func((char **)cfg_keybinds[i].cmd);
-      xcb_flush(core.c);
-    }
+static int tfwm_ipc_path(char *buf, size_t n) {
+  char display[TFWM_DISPLAY_LEN];
+  tfwm_util_display(display, sizeof(display));
+  char *dir = getenv("XDG_RUNTIME_DIR");
+  int len = snprintf(buf, n, "%s/", dir ? dir : "/tmp");
+  if ((len < 0) || ((size_t)len >= n)) {
+    return -1;
   }
+  int m = snprintf(buf + len, n - len, TFWM_SOCKET_FILE, display);
+  return ((m < 0) || ((size_t)m >= n - len)) ? -1 : 0;
 }
 
-void tfwm_handle_map_request(xcb_generic_event_t *event) {
-  xcb_map_request_event_t *e = (xcb_map_request_event_t *)event;
+static void tfwm_ipc_init(void) {
+  core.ipc.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (core.ipc.fd < 0) {
+    TFWM_LOG(TFWM_LOG_WARN, TFWM_SYS_IPC, "can not create socket");
+    return;
+  }
+  fcntl(core.ipc.fd, F_SETFD, FD_CLOEXEC);
+  fcntl(core.ipc.fd, F_SETFL, O_NONBLOCK);
 
-  uint32_t vs[5];
-  vs[0] = (core.sc->width_in_pixels / 2) - (TFWM_WINDOW_WIDTH / 2);
-  vs[1] = (core.sc->height_in_pixels / 2) - (TFWM_WINDOW_HEIGHT / 2);
-  vs[2] = TFWM_WINDOW_WIDTH;
-  vs[3] = TFWM_WINDOW_HEIGHT;
-  vs[4] = TFWM_BORDER_WIDTH;
-  xcb_configure_window(
-      core.c,
-      e->window,
-      XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH |
-          XCB_CONFIG_WINDOW_HEIGHT | XCB_CONFIG_WINDOW_BORDER_WIDTH,
-      vs
-  );
-  uint32_t atvs[1] = {XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_FOCUS_CHANGE};
-  xcb_change_window_attributes(core.c, e->window, XCB_CW_EVENT_MASK, atvs);
-  xcb_map_window(core.c, e->window);
-  xcb_flush(core.c);
+  struct sockaddr_un addr = {0};
+  addr.sun_family = AF_UNIX;
+  if (tfwm_ipc_path(addr.sun_path, sizeof(addr.sun_path)) < 0) {
+    TFWM_LOG(TFWM_LOG_WARN, TFWM_SYS_IPC, "socket path too long");
+    close(core.ipc.fd);
+    core.ipc.fd = -1;
+    return;
+  }
 
-  tfwm_window_t w;
-  w.x = vs[0];
-  w.y = vs[1];
-  w.w = vs[2];
-  w.h = vs[3];
-  w.b = vs[4];
-  w.win = e->window;
-  char *wmc = tfwm_util_window_class(e->window);
-  w.class = malloc(strlen(wmc) * sizeof(char));
-  strcpy(w.class, wmc);
+  int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (probe >= 0) {
+    if ((connect(probe, (struct sockaddr *)&addr, sizeof(addr)) < 0) &&
+        (ECONNREFUSED == errno)) {
+      unlink(addr.sun_path);
+    }
+    close(probe);
+  }
 
-  tfwm_workspace_window_append(core.cur_ws, w);
-  tfwm_layout_update(core.cur_ws);
-  tfwm_workspace_window_map(core.cur_ws);
-  xcb_clear_area(core.c, 1, core.bar, 0, 0, 0, 0);
+  mode_t mask = umask(0177);
+  int ret = bind(core.ipc.fd, (struct sockaddr *)&addr, sizeof(addr));
+  umask(mask);
+  if ((ret < 0) || (listen(core.ipc.fd, TFWM_IPC_CLIENTS) < 0) ||
+      (tfwm_loop_add(core.ipc.fd, EPOLLIN, tfwm_ipc_accept) < 0)) {
+    TFWM_LOG(TFWM_LOG_WARN, TFWM_SYS_IPC, "can not listen on %s", addr.sun_path);
+    close(core.ipc.fd);
+    core.ipc.fd = -1;
+  }
 }
 
-void tfwm_handle_focus_in(xcb_generic_event_t *event) {
-  xcb_focus_in_event_t *e = (xcb_focus_in_event_t *)event;
-  tfwm_window_color(e->event, TFWM_BORDER_ACTIVE);
+static void tfwm_ipc_accept(int fd, uint32_t events) {
+  for (;;) {
+    int cfd = accept(fd, NULL, NULL);
+    if (cfd < 0) {
+      return;
+    }
+    if ((core.ipc.len == TFWM_IPC_CLIENTS) ||
+        (tfwm_loop_add(cfd, EPOLLIN, tfwm_ipc_event) < 0)) {
+      close(cfd);
+      continue;
+    }
+    fcntl(cfd, F_SETFD, FD_CLOEXEC);
+    fcntl(cfd, F_SETFL, O_NONBLOCK);
+    core.ipc.list[core.ipc.len++] = (tfwm_ipc_client_t){.fd = cfd};
+  }
 }
 
-void tfwm_handle_focus_out(xcb_generic_event_t *event) {
-  xcb_focus_out_event_t *e = (xcb_focus_out_event_t *)event;
-  tfwm_window_color(e->event, TFWM_BORDER_INACTIVE);
+static void tfwm_ipc_event(int fd, uint32_t events) {
+  for (uint32_t i = 0; i < core.ipc.len; i++) {
+    tfwm_ipc_client_t *cl = &core.ipc.list[i];
+    if (((fd) != cl->fd) || cl->done) {
+      continue;
+    }
+    if (tfwm_ipc_read(cl)) {
+      tfwm_loop_del(fd);
+      tfwm_ipc_exec(cl);
+    }
+    return;
+  }
 }
 
-void tfwm_handle_enter_notify(xcb_generic_event_t *event) {
-  xcb_enter_notify_event_t *e = (xcb_enter_notify_event_t *)event;
-}
+static int tfwm_ipc_read(tfwm_ipc_client_t *cl) {
+  for (;;) {
+    if ((cl->cap - cl->len) < 2) {
+      size_t cap = cl->cap ? cl->cap * 2 : TFWM_IPC_ALLOC;
+      char *buf = (cap <= TFWM_IPC_MAX) ? realloc(cl->buf, cap) : NULL;
+      if (!buf) {
+        cl->overflow = 1;
+        cl->done = 1;
+        return 1;
+      }
+      cl->buf = buf;
+      cl->cap = cap;
+    }
 
-void tfwm_handle_leave_notify(xcb_generic_event_t *event) {
-  xcb_leave_notify_event_t *e = (xcb_leave_notify_event_t *)event;
+    ssize_t n = read(cl->fd, cl->buf + cl->len, cl->cap - cl->len - 1);
+    if (n > 0) {
+      cl->len += n;
+      continue;
+    }
+    if ((n < 0) && ((EAGAIN == errno) || (EINTR == errno))) {
+      return 0;
+    }
+    cl->done = 1;
+    return 1;
+  }
 }
 
-void tfwm_handle_motion_notify(xcb_generic_event_t *event) {
-  if (0 == core.win) {
+static void tfwm_ipc_exec(tfwm_ipc_client_t *cl) {
+  FILE *f = open_memstream(&cl->reply, &cl->reply_len);
+  if (!f) {
     return;
   }
-  if ((core.win) == core.sc->root) {
+  if (cl->overflow) {
+    fprintf(f, "error batch exceeds %zu bytes\n", TFWM_IPC_MAX);
+    fclose(f);
     return;
   }
-  if (TFWM_LAYOUT_FLOATING != core.ws_list[core.cur_ws].layout) {
+  if (!cl->buf) {
+    fclose(f);
     return;
   }
+  cl->buf[cl->len] = '\0';
+
+  char *save_line;
+  for (char *line = strtok_r(cl->buf, TFWM_IPC_DELIM, &save_line); line;
+       line = strtok_r(NULL, TFWM_IPC_DELIM, &save_line)) {
+    char *args[TFWM_IPC_ARGS + 1] = {0};
+    int argc = 0;
+    char *save_arg;
+    for (char *a = strtok_r(line, " \t\r", &save_arg);
+         a && (argc < TFWM_IPC_ARGS);
+         a = strtok_r(NULL, " \t\r", &save_arg)) {
+      args[argc++] = a;
+    }
+    if (0 == argc) {
+      continue;
+    }
 
-  xcb_motion_notify_event_t *e = (xcb_motion_notify_event_t *)event;
-  xcb_query_pointer_reply_t *pt = xcb_query_pointer_reply(
-      core.c, xcb_query_pointer(core.c, core.sc->root), NULL
-  );
-  if (!pt) {
-    return;
+    const tfwm_command_t *cmd = NULL;
+    for (size_t i = 0; i < ARRAY_LENGTH(TFWM_COMMAND); i++) {
+      if (strcmp(args[0], TFWM_COMMAND[i].name) == 0) {
+        cmd = &TFWM_COMMAND[i];
+        break;
+      }
+    }
+    if (!cmd) {
+      fprintf(f, "error unknown command %s\n", args[0]);
+      continue;
+    }
+    if ((argc - 1) < cmd->argc) {
+      fprintf(f, "error missing argument %s\n", args[0]);
+      continue;
+    }
+
+    TFWM_LOG(TFWM_LOG_DEBUG, TFWM_SYS_IPC, "command %s", args[0]);
+    cmd->func(args + 1);
+    if ((tfwm_window_spawn == cmd->func) && (core.launch.last < 0)) {
+      fprintf(f, "error can not spawn %s\n", args[1]);
+    } else if (tfwm_window_spawn == cmd->func) {
+      fprintf(f, "ok %d\n", (int)core.launch.last);
+    } else {
+      fprintf(f, "ok\n");
+    }
   }
+  fclose(f);
+}
 
-  xcb_get_geometry_reply_t *g =
-      xcb_get_geometry_reply(core.c, xcb_get_geometry(core.c, core.win), NULL);
-  if (!g) {
-    free(pt);
-    return;
+static int tfwm_ipc_send(tfwm_ipc_client_t *cl) {
+  while (cl->reply && (cl->sent < cl->reply_len)) {
+    ssize_t n = send(
+        cl->fd, cl->reply + cl->sent, cl->reply_len - cl->sent, MSG_NOSIGNAL
+    );
+    if (n > 0) {
+      cl->sent += n;
+      continue;
+    }
+    if ((n < 0) && (EINTR == errno)) {
+      continue;
+    }
+    if ((n < 0) && (EAGAIN == errno) && !cl->wait) {
+      cl->wait = (tfwm_loop_add(cl->fd, EPOLLOUT, tfwm_ipc_write) == 0);
+    }
+    if ((n < 0) && (EAGAIN == errno) && cl->wait) {
+      return 0;
+    }
+    break;
   }
 
-  if ((uint32_t)(BTN_LEFT) == core.cur_btn) {
-    if ((core.ptr_x == pt->root_x) && (core.ptr_y == pt->root_y)) {
-      free(pt);
-      free(g);
+  if (cl->wait) {
+    tfwm_loop_del(cl->fd);
+    cl->wait = 0;
+  }
+  return 1;
+}
+
+static void tfwm_ipc_write(int fd, uint32_t events) {
+  for (uint32_t i = 0; i < core.ipc.len; i++) {
+    if ((fd) == core.ipc.list[i].fd) {
+      tfwm_ipc_send(&core.ipc.list[i]);
       return;
     }
+  }
+}
 
-    int x = g->x + pt->root_x - core.ptr_x;
-    int y = g->y + pt->root_y - core.ptr_y;
-    core.ptr_x = pt->root_x;
-    core.ptr_y = pt->root_y;
-    tfwm_window_move(core.win, x, y);
-  } else if ((uint32_t)(BTN_RIGHT) == core.cur_btn) {
-    if ((pt->root_x <= g->x) || (pt->root_y <= g->y)) {
-      free(pt);
-      free(g);
-      return;
+static void tfwm_ipc_reply(void) {
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < core.ipc.len; i++) {
+    tfwm_ipc_client_t *cl = &core.ipc.list[i];
+    if (!cl->done || !tfwm_ipc_send(cl)) {
+      core.ipc.list[n++] = *cl;
+      continue;
     }
 
-    int w = g->width + (pt->root_x - core.ptr_x);
-    int h = g->height + (pt->root_y - core.ptr_y);
-    core.ptr_x = pt->root_x;
-    core.ptr_y = pt->root_y;
-    tfwm_window_resize(core.win, w, h);
+    free(cl->reply);
+    free(cl->buf);
+    close(cl->fd);
   }
-
-  free(pt);
-  free(g);
+  core.ipc.len = n;
 }
 
-void tfwm_handle_destroy_notify(xcb_generic_event_t *event) {
-  xcb_destroy_notify_event_t *e = (xcb_destroy_notify_event_t *)event;
-  xcb_kill_client(core.c, e->window);
+static void tfwm_ipc_cleanup(void) {
+  for (uint32_t i = 0; i < core.ipc.len; i++) {
+    core.ipc.list[i].done = 1;
+  }
+  tfwm_ipc_reply();
+  for (uint32_t i = 0; i < core.ipc.len; i++) {
+    free(core.ipc.list[i].reply);
+    free(core.ipc.list[i].buf);
+    close(core.ipc.list[i].fd);
+  }
+  core.ipc.len = 0;
+  if (core.ipc.fd >= 0) {
+    close(core.ipc.fd);
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    if (tfwm_ipc_path(path, sizeof(path)) == 0) {
+      unlink(path);
+    }
+  }
 }
 
-void tfwm_handle_button_press(xcb_generic_event_t *event) {
-  xcb_button_press_event_t *e = (xcb_button_press_event_t *)event;
-  core.win = e->child;
-  core.ptr_x = e->event_x;
-  core.ptr_y = e->event_y;
-  tfwm_window_focus(core.win);
+static int tfwm_ipc_client(void) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr = {0};
+  addr.sun_family = AF_UNIX;
+  if ((fd < 0) || (tfwm_ipc_path(addr.sun_path, sizeof(addr.sun_path)) < 0) ||
+      (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)) {
+    printf("ERROR: can not connect to %s\n", addr.sun_path);
+    return EXIT_FAILURE;
+  }
 
-  core.cur_btn =
-      ((e->detail == BTN_LEFT) ? BTN_LEFT : ((core.win != 0) ? BTN_RIGHT : 0));
-  xcb_cursor_t csr = XCB_NONE;
-  if ((uint32_t)BTN_LEFT == core.cur_btn) {
-    csr = tfwm_util_cursor((char *)TFWM_CURSOR_MOVE);
-  } else if ((uint32_t)BTN_RIGHT == core.cur_btn) {
-    csr = tfwm_util_cursor((char *)TFWM_CURSOR_RESIZE);
+  char buf[BUFSIZ];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0) {
+    if (write(fd, buf, n) < 0) {
+      close(fd);
+      return EXIT_FAILURE;
+    }
   }
-  xcb_grab_pointer(
-      core.c,
-      0,
-      core.sc->root,
-      XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_BUTTON_MOTION |
-          XCB_EVENT_MASK_POINTER_MOTION_HINT,
-      XCB_GRAB_MODE_ASYNC,
-      XCB_GRAB_MODE_ASYNC,
-      core.sc->root,
-      csr,
-      XCB_CURRENT_TIME
-  );
+  shutdown(fd, SHUT_WR);
+
+  int ret = EXIT_SUCCESS;
+  ssize_t r;
+  while ((r = read(fd, buf, sizeof(buf) - 1)) > 0) {
+    buf[r] = '\0';
+    if (strstr(buf, "error")) {
+      ret = EXIT_FAILURE;
+    }
+    fputs(buf, stdout);
+  }
+  close(fd);
+  return ret;
 }
 
-void tfwm_handle_button_release(xcb_generic_event_t *event) {
-  xcb_get_geometry_reply_t *g =
-      xcb_get_geometry_reply(core.c, xcb_get_geometry(core.c, core.win), NULL);
-  if (!g) {
-    return;
+static void tfwm_handle_dispatch(xcb_generic_event_t *event) {
+  uint8_t e = event->response_type & ~0x80;
+  core.stats.evt[e]++;
+  if (core.randr && ((core.randr + XCB_RANDR_SCREEN_CHANGE_NOTIFY == e) ||
+                     (core.randr + XCB_RANDR_NOTIFY == e))) {
+    tfwm_handle_screen_change(event);
+  } else if (event_handlers[e]) {
+    uint64_t t = tfwm_stats_now();
+    event_handlers[e](event);
+    tfwm_stats_latency(core.stats.hist[e], tfwm_stats_now() - t);
+    tfwm_trace_end(TFWM_TRACE_EVENT, e, t, tfwm_trace_window(event));
   }
+}
 
-  tfwm_window_set_attr(core.win, g->x, g->y, g->width, g->height);
-  free(g);
-  xcb_ungrab_pointer(core.c, XCB_CURRENT_TIME);
+static xcb_generic_event_t *tfwm_handle_wait(void) {
+  for (;;) {
+    xcb_generic_event_t *event = xcb_poll_for_event(core.c);
+    if (event || xcb_connection_has_error(core.c)) {
+      return event;
+    }
+
+    if (core.pending.len) {
+      tfwm_map_complete();
+    }
+    tfwm_stats_flush();
+    tfwm_log_drain();
+    event = xcb_poll_for_queued_event(core.c);
+    if (event) {
+      return event;
+    }
+
+    struct epoll_event evs[TFWM_LOOP_EVENTS];
+    int n = epoll_wait(core.loop.fd, evs, TFWM_LOOP_EVENTS, -1);
+    if ((n < 0) && (EINTR != errno)) {
+      return NULL;
+    }
 
-  return;
+    int ran = 0;
+    for (int i = 0; i < n; i++) {
+      tfwm_source_t src = core.loop.list[evs[i].data.u32];
+      if ((src.fd < 0) || !src.func) {
+        continue;
+      }
+      src.func(src.fd, evs[i].events);
+      ran = 1;
+    }
+    if (ran) {
+      return NULL;
+    }
+  }
 }
 
 static int tfwm_handle_event(void) {
@@ -840,54 +3311,56 @@ static int tfwm_handle_event(void) {
     return ret;
   }
 
-  xcb_generic_event_t *event = xcb_wait_for_event(core.c);
-  if (!event) {
-    return ret;
-  }
-
-  tfwm_event_handler_t *handler;
-  for (handler = event_handlers; handler->func; handler++) {
-    uint8_t e = event->response_type & ~0x80;
-    if (e == handler->req) {
-      handler->func(event);
+  xcb_generic_event_t *event = tfwm_handle_wait();
+  while (event) {
+    tfwm_handle_dispatch(event);
+    free(event);
+    if (core.quit) {
+      break;
     }
+    event = xcb_poll_for_queued_event(core.c);
   }
+  tfwm_map_complete();
 
-  free(event);
-  xcb_flush(core.c);
-  return ret;
+  return xcb_connection_has_error(core.c);
 }
 
-static void tfwm_bar_render_left(xcb_gcontext_t gc, char *text) {
+static void tfwm_bar_render_left(tfwm_output_t *o, xcb_gcontext_t gc, char *text) {
   xcb_image_text_8(
-      core.c, strlen(text), core.bar, gc, core.bar_l, TFWM_FONT_HEIGHT, text
+      core.c, strlen(text), o->bar_pm, gc, o->bar_l, TFWM_FONT_HEIGHT, text
   );
-  core.bar_l += tfwm_util_text_width(text);
+  o->bar_l += tfwm_util_text_width(text);
 }
 
-static void tfwm_bar_render_right(xcb_gcontext_t gc, char *text) {
-  core.bar_r -= tfwm_util_text_width(text);
+static void tfwm_bar_render_right(tfwm_output_t *o, xcb_gcontext_t gc, char *text) {
+  o->bar_r -= tfwm_util_text_width(text);
   xcb_image_text_8(
-      core.c, strlen(text), core.bar, gc, core.bar_r, TFWM_FONT_HEIGHT, text
+      core.c, strlen(text), o->bar_pm, gc, o->bar_r, TFWM_FONT_HEIGHT, text
   );
 }
 
-static void tfwm_bar_module_layout(void (*render)(xcb_gcontext_t, char *)) {
+static void tfwm_bar_module_layout(
+    tfwm_output_t *o, void (*render)(tfwm_output_t *, xcb_gcontext_t, char *)
+) {
   size_t n = ARRAY_LENGTH(cfg_layout);
 
   for (size_t i = 0; i < n; i++) {
-    if (core.ws_list[core.cur_ws].layout == cfg_layout[i].layout) {
-      render(core.gc_inactive, cfg_layout[i].sym);
+    if (core.ws_list[o->wsid].layout == cfg_layout[i].layout) {
+      render(o, core.gc_inactive, cfg_layout[i].sym);
       break;
     }
   }
 }
 
-static void tfwm_bar_module_separator(void (*render)(xcb_gcontext_t, char *)) {
-  render(core.gc_inactive, (char *)TFWM_BAR_SEPARATOR);
+static void tfwm_bar_module_separator(
+    tfwm_output_t *o, void (*render)(tfwm_output_t *, xcb_gcontext_t, char *)
+) {
+  render(o, core.gc_inactive, (char *)TFWM_BAR_SEPARATOR);
 }
 
-static void tfwm_bar_module_workspace(void (*render)(xcb_gcontext_t, char *)) {
+static void tfwm_bar_module_workspace(
+    tfwm_output_t *o, void (*render)(tfwm_output_t *, xcb_gcontext_t, char *)
+) {
   for (uint32_t i = 0; i < core.ws_len; i++) {
     size_t n = strlen(core.ws_list[i].name);
     char ws[n + 3];
@@ -895,15 +3368,17 @@ static void tfwm_bar_module_workspace(void (*render)(xcb_gcontext_t, char *)) {
     memcpy(ws + 1, core.ws_list[i].name, n);
     ws[n + 1] = ' ';
     ws[n + 2] = '\0';
-    if (i == core.cur_ws) {
-      render(core.gc_active, ws);
+    if (i == o->wsid) {
+      render(o, core.gc_active, ws);
     } else {
-      render(core.gc_inactive, ws);
+      render(o, core.gc_inactive, ws);
     }
   }
 }
 
-static void tfwm_bar_module_wm_info(void (*render)(xcb_gcontext_t, char *)) {
+static void tfwm_bar_module_wm_info(
+    tfwm_output_t *o, void (*render)(tfwm_output_t *, xcb_gcontext_t, char *)
+) {
   size_t n1 = strlen(TFWM_NAME);
   size_t n2 = strlen(TFWM_VERSION);
   char s[n1 + n2 + 2];
@@ -911,18 +3386,25 @@ static void tfwm_bar_module_wm_info(void (*render)(xcb_gcontext_t, char *)) {
   s[n1] = '-';
   memcpy(s + n1 + 1, TFWM_VERSION, n2);
   s[n1 + 1 + n2] = '\0';
-  render(core.gc_inactive, s);
+  render(o, core.gc_inactive, s);
 }
 
-static void tfwm_bar_module_window_tabs() {
-  if (0 == core.win) {
+static void tfwm_bar_module_clock(
+    tfwm_output_t *o, void (*render)(tfwm_output_t *, xcb_gcontext_t, char *)
+) {
+  if (0 == core.clock[0]) {
     return;
   }
-  if ((core.win) == core.sc->root) {
-    return;
+  render(o, core.gc_inactive, core.clock);
+}
+
+static void tfwm_bar_module_window_tabs(tfwm_output_t *o) {
+  tfwm_workspace_t *ws = &core.ws_list[o->wsid];
+  tfwm_window_t *cur = tfwm_arena_get(ws->focus);
+  if (!cur) {
+    cur = tfwm_arena_get(ws->tail);
   }
-  tfwm_workspace_t *ws = &core.ws_list[core.cur_ws];
-  if (0 == ws->win_len) {
+  if (!cur) {
     return;
   }
 
@@ -931,95 +3413,161 @@ static void tfwm_bar_module_window_tabs() {
   int p_sign_w = tfwm_util_text_width(p_sign);
   int n_sign_w = tfwm_util_text_width(n_sign);
   int sep_w = tfwm_util_text_width(" ");
-  int max = core.bar_r - (core.bar_l + p_sign_w + n_sign_w);
-  int n = tfwm_util_text_width(ws->win_list[core.cur_win].class) + (2 * sep_w);
-  int last = ws->win_len - 1;
-  int head = core.cur_win > 0 ? core.cur_win - 1 : 0;
-  int tail = core.cur_win < last ? core.cur_win + 1 : last;
-  int head_done = core.cur_win == head ? 1 : 0;
-  int tail_done = core.cur_win == tail ? 1 : 0;
+  int max = o->bar_r - (o->bar_l + p_sign_w + n_sign_w);
+  int n = tfwm_util_text_width(cur->class) + (2 * sep_w);
+  tfwm_window_t *head = cur;
+  tfwm_window_t *tail = cur;
 
   while (n < max) {
-    if (head >= 0 && !head_done) {
-      n += tfwm_util_text_width(ws->win_list[head].class) + (2 * sep_w);
+    tfwm_window_t *p = tfwm_arena_get(head->prev);
+    tfwm_window_t *q = tfwm_arena_get(tail->next);
+    if (!p && !q) {
+      break;
+    }
+
+    if (p) {
+      n += tfwm_util_text_width(p->class) + (2 * sep_w);
       if (n >= max) {
-        tail -= !tail_done ? 1 : 0;
         break;
-      } else if (head == 0) {
-        head_done = 1;
-      } else {
-        head--;
       }
+      head = p;
     }
 
-    if (tail <= last && !tail_done) {
-      n += tfwm_util_text_width(ws->win_list[tail].class) + (2 * sep_w);
+    if (q) {
+      n += tfwm_util_text_width(q->class) + (2 * sep_w);
       if (n >= max) {
-        head += !head_done ? 1 : 0;
         break;
-      } else if (tail == last) {
-        tail_done = 1;
-      } else {
-        tail++;
       }
-    }
-
-    if (head_done && tail_done) {
-      break;
+      tail = q;
     }
   }
 
-  if (head > 0) {
-    tfwm_bar_render_left(core.gc_inactive, p_sign);
+  if (head->prev) {
+    tfwm_bar_render_left(o, core.gc_inactive, p_sign);
   } else {
-    core.bar_l += p_sign_w;
+    o->bar_l += p_sign_w;
   }
-  if (tail < last) {
-    tfwm_bar_render_right(core.gc_inactive, n_sign);
+  if (tail->next) {
+    tfwm_bar_render_right(o, core.gc_inactive, n_sign);
   } else {
-    core.bar_r -= n_sign_w;
+    o->bar_r -= n_sign_w;
   }
 
-  for (int i = head; i <= tail; i++) {
-    size_t n = strlen(ws->win_list[i].class);
+  for (tfwm_window_t *w = head;; w = tfwm_arena_get(w->next)) {
+    size_t n = strlen(w->class);
     char c[n + 3];
     c[0] = ' ';
-    memcpy(c + 1, ws->win_list[i].class, n);
+    memcpy(c + 1, w->class, n);
     c[n + 1] = ' ';
     c[n + 2] = '\0';
-    if (i == core.cur_win) {
-      tfwm_bar_render_left(core.gc_active, c);
+    if (w == cur) {
+      tfwm_bar_render_left(o, core.gc_active, c);
     } else {
-      tfwm_bar_render_left(core.gc_inactive, c);
+      tfwm_bar_render_left(o, core.gc_inactive, c);
+    }
+    if (w == tail) {
+      break;
     }
   }
 }
 
-static void tfwm_bar() {
-  core.bar_l = 0;
-  core.bar_r = core.sc->width_in_pixels;
+static void tfwm_bar_clear(tfwm_output_t *o, int x, int w) {
+  if (w <= 0) {
+    return;
+  }
 
-  tfwm_bar_module_workspace(tfwm_bar_render_left);
-  tfwm_bar_module_separator(tfwm_bar_render_left);
-  tfwm_bar_module_layout(tfwm_bar_render_left);
-  tfwm_bar_module_separator(tfwm_bar_render_left);
+  xcb_rectangle_t r = {x, 0, w, TFWM_BAR_HEIGHT};
+  xcb_poly_fill_rectangle(core.c, o->bar_pm, core.gc_background, 1, &r);
+}
 
-  tfwm_bar_module_wm_info(tfwm_bar_render_right);
-  tfwm_bar_module_separator(tfwm_bar_render_right);
+static void tfwm_bar_tick(int fd, uint32_t events) {
+  uint64_t exp;
+  if (fd >= 0) {
+    while (read(fd, &exp, sizeof(exp)) > 0) {
+    }
+  }
 
-  tfwm_bar_module_window_tabs();
+  char clock[TFWM_CLOCK_LEN] = {0};
+  time_t t = time(NULL);
+  strftime(clock, sizeof(clock), TFWM_BAR_CLOCK, localtime(&t));
+  if (strcmp(clock, core.clock) != 0) {
+    memcpy(core.clock, clock, sizeof(clock));
+    core.bar_dirty |= TFWM_BAR_INFO;
+  }
+}
+
+static void tfwm_bar_draw(tfwm_output_t *o) {
+  uint32_t dirty = core.bar_dirty;
+  if (dirty & (TFWM_BAR_WORKSPACE | TFWM_BAR_LAYOUT)) {
+    tfwm_bar_clear(o, 0, o->bar_tabs_l);
+    o->bar_l = 0;
+    tfwm_bar_module_workspace(o, tfwm_bar_render_left);
+    tfwm_bar_module_separator(o, tfwm_bar_render_left);
+    tfwm_bar_module_layout(o, tfwm_bar_render_left);
+    tfwm_bar_module_separator(o, tfwm_bar_render_left);
+    if (o->bar_l != o->bar_tabs_l) {
+      o->bar_tabs_l = o->bar_l;
+      dirty |= TFWM_BAR_TABS;
+    }
+  }
 
-  xcb_flush(core.c);
+  if (dirty & TFWM_BAR_INFO) {
+    tfwm_bar_clear(o, o->bar_tabs_r, o->geom.w - o->bar_tabs_r);
+    o->bar_r = o->geom.w;
+    tfwm_bar_module_wm_info(o, tfwm_bar_render_right);
+    tfwm_bar_module_separator(o, tfwm_bar_render_right);
+    if (core.clock[0]) {
+      tfwm_bar_module_clock(o, tfwm_bar_render_right);
+      tfwm_bar_module_separator(o, tfwm_bar_render_right);
+    }
+    if (o->bar_r != o->bar_tabs_r) {
+      o->bar_tabs_r = o->bar_r;
+      dirty |= TFWM_BAR_TABS;
+    }
+  }
+
+  if (dirty & TFWM_BAR_TABS) {
+    tfwm_bar_clear(o, o->bar_tabs_l, o->bar_tabs_r - o->bar_tabs_l);
+    o->bar_l = o->bar_tabs_l;
+    o->bar_r = o->bar_tabs_r;
+    tfwm_bar_module_window_tabs(o);
+  }
+
+  xcb_copy_area(
+      core.c,
+      o->bar_pm,
+      o->bar,
+      core.gc_inactive,
+      0,
+      0,
+      0,
+      0,
+      o->geom.w,
+      TFWM_BAR_HEIGHT
+  );
+}
+
+static void tfwm_bar(void) {
+  if (0 == core.bar_dirty) {
+    return;
+  }
+
+  uint64_t t = tfwm_trace_begin();
+  for (uint32_t i = 0; i < core.out_len; i++) {
+    tfwm_bar_draw(&core.out_list[i]);
+  }
+  tfwm_trace_end(TFWM_TRACE_BAR, core.bar_dirty, t, 0);
+  core.bar_dirty = 0;
 }
 
 static void tfwm_ewmh_supported(void) {
   size_t n = ARRAY_LENGTH(TFWM_SUPPORTED_ATOM);
   xcb_atom_t as[n];
   for (size_t i = 0; i < n; i++) {
-    as[i] = tfwm_util_atom((char *)TFWM_SUPPORTED_ATOM[i]);
+    as[i] = core.atom[TFWM_SUPPORTED_ATOM[i]];
   }
 
-  xcb_atom_t a = tfwm_util_atom("_NET_SUPPORTED");
+  xcb_atom_t a = core.atom[TFWM_ATOM_NET_SUPPORTED];
   if (!a) {
     return;
   }
@@ -1029,7 +3577,7 @@ static void tfwm_ewmh_supported(void) {
 }
 
 static void tfwm_ewmh_desktop_viewport() {
-  xcb_atom_t a = tfwm_util_atom("_NET_DESKTOP_VIEWPORT");
+  xcb_atom_t a = core.atom[TFWM_ATOM_NET_DESKTOP_VIEWPORT];
   if (!a) {
     return;
   }
@@ -1041,7 +3589,7 @@ static void tfwm_ewmh_desktop_viewport() {
 }
 
 static void tfwm_ewmh_current_desktop() {
-  xcb_atom_t a = tfwm_util_atom("_NET_CURRENT_DESKTOP");
+  xcb_atom_t a = core.atom[TFWM_ATOM_NET_CURRENT_DESKTOP];
   if (!a) {
     return;
   }
@@ -1052,15 +3600,15 @@ static void tfwm_ewmh_current_desktop() {
 }
 
 static void tfwm_ewmh_workarea() {
-  xcb_atom_t a = tfwm_util_atom("_NET_WORKAREA");
+  xcb_atom_t a = core.atom[TFWM_ATOM_NET_WORKAREA];
   if (!a) {
     return;
   }
   uint32_t v[] = {
       0,
       TFWM_BAR_HEIGHT,
-      core.sc->width_in_pixels,
-      core.sc->height_in_pixels - TFWM_BAR_HEIGHT
+      core.root_w,
+      core.root_h - TFWM_BAR_HEIGHT
   };
   xcb_change_property(
       core.c,
@@ -1075,7 +3623,7 @@ static void tfwm_ewmh_workarea() {
 }
 
 static void tfwm_ewmh_supporting_wm_check(xcb_window_t wid) {
-  xcb_atom_t a1 = tfwm_util_atom("_NET_SUPPORTING_WM_CHECK");
+  xcb_atom_t a1 = core.atom[TFWM_ATOM_NET_SUPPORTING_WM_CHECK];
   if (!a1) {
     return;
   }
@@ -1086,7 +3634,7 @@ static void tfwm_ewmh_supporting_wm_check(xcb_window_t wid) {
       core.c, XCB_PROP_MODE_REPLACE, wid, a1, XCB_ATOM_WINDOW, 32, 1, &wid
   );
 
-  xcb_atom_t a2 = tfwm_util_atom("_NET_WM_NAME");
+  xcb_atom_t a2 = core.atom[TFWM_ATOM_NET_WM_NAME];
   if (!a2) {
     return;
   }
@@ -1127,141 +3675,128 @@ static void tfwm_ewmh() {
   tfwm_ewmh_supporting_wm_check(wid);
 }
 
+static void tfwm_init_request(tfwm_init_t *in) {
+  for (int i = 0; i < TFWM_ATOM_LEN; i++) {
+    in->atom[i] = xcb_intern_atom(
+        core.c, 0, strlen(TFWM_ATOM_NAME[i]), TFWM_ATOM_NAME[i]
+    );
+  }
+  core.font = xcb_generate_id(core.c);
+  xcb_open_font(core.c, core.font, strlen(TFWM_FONT), TFWM_FONT);
+  in->font = xcb_query_font(core.c, core.font);
+  core.kbd.syms = xcb_key_symbols_alloc(core.c);
+  in->modmap = xcb_get_modifier_mapping(core.c);
+  xcb_prefetch_extension_data(core.c, &xcb_randr_id);
+  in->tree = xcb_query_tree(core.c, core.sc->root);
+}
+
 static void tfwm_init(void) {
-  xcb_cursor_t csr = tfwm_util_cursor((char *)TFWM_CURSOR_DEFAULT);
+  core.stats.start = tfwm_stats_now();
+  tfwm_init_t in;
+  tfwm_init_request(&in);
+  tfwm_config_load();
+
+  tfwm_util_cursors();
   uint32_t vals[2] = {
       XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_STRUCTURE_NOTIFY |
           XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE,
-      csr
+      core.cursor[TFWM_CSR_DEFAULT]
   };
   xcb_change_window_attributes(
       core.c, core.sc->root, XCB_CW_EVENT_MASK | XCB_CW_CURSOR, vals
   );
 
-  xcb_ungrab_key(core.c, XCB_GRAB_ANY, core.sc->root, XCB_MOD_MASK_ANY);
-  for (int i = 0; i < ARRAY_LENGTH(cfg_keybinds); i++) {
-    xcb_keycode_t *keycode = tfwm_util_keycodes(cfg_keybinds[i].keysym);
-    if (keycode != NULL) {
-      xcb_grab_key(
-          core.c,
-          1,
-          core.sc->root,
-          cfg_keybinds[i].mod,
-          *keycode,
-          XCB_GRAB_MODE_ASYNC,
-          XCB_GRAB_MODE_ASYNC
-      );
-      free(keycode);
-    }
-  }
-  xcb_flush(core.c);
-
-  xcb_grab_button(
+  tfwm_util_atoms(in.atom);
+  in.session = xcb_get_property(
       core.c,
       0,
       core.sc->root,
-      XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE,
-      XCB_GRAB_MODE_ASYNC,
-      XCB_GRAB_MODE_ASYNC,
-      core.sc->root,
-      XCB_NONE,
-      BTN_LEFT,
-      MOD_KEY
-  );
-  xcb_grab_button(
-      core.c,
+      core.atom[TFWM_ATOM_TFWM_SESSION],
+      XCB_ATOM_CARDINAL,
       0,
-      core.sc->root,
-      XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE,
-      XCB_GRAB_MODE_ASYNC,
-      XCB_GRAB_MODE_ASYNC,
-      core.sc->root,
-      XCB_NONE,
-      BTN_RIGHT,
-      MOD_KEY
+      1
   );
-  xcb_flush(core.c);
+  tfwm_keyboard_load(in.modmap);
+  tfwm_util_font_metrics(in.font);
 
+  tfwm_journal_open();
   core.ws_len = ARRAY_LENGTH(cfg_workspace);
   core.ws_list = malloc(core.ws_len * sizeof(tfwm_workspace_t));
   for (uint32_t i = 0; i < core.ws_len; i++) {
-    tfwm_workspace_t ws;
+    tfwm_workspace_t ws = {0};
     ws.layout = cfg_layout[0].layout;
     ws.name = cfg_workspace[i];
     core.ws_list[i] = ws;
+    tfwm_workspace_container(i);
   }
 
-  core.bar = xcb_generate_id(core.c);
-  uint32_t bvs[3];
-  bvs[0] = TFWM_BAR_BACKGROUND;
-  bvs[1] = 1;
-  bvs[2] = XCB_EVENT_MASK_EXPOSURE;
-  xcb_create_window(
-      core.c,
-      XCB_COPY_FROM_PARENT,
-      core.bar,
-      core.sc->root,
-      0,
-      0,
-      core.sc->width_in_pixels,
-      TFWM_BAR_HEIGHT,
-      0,
-      XCB_WINDOW_CLASS_INPUT_OUTPUT,
-      core.sc->root_visual,
-      XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK,
-      bvs
-  );
-  uint32_t bar_cfg_vals[1] = {XCB_STACK_MODE_ABOVE};
-  xcb_configure_window(core.c, core.bar, XCB_CONFIG_WINDOW_STACK_MODE, bar_cfg_vals);
-  xcb_map_window(core.c, core.bar);
-  xcb_flush(core.c);
-
-  core.font = xcb_generate_id(core.c);
-  xcb_open_font(core.c, core.font, strlen(TFWM_FONT), TFWM_FONT);
-
   core.gc_active = xcb_generate_id(core.c);
   uint32_t acvs[3];
-  acvs[0] = TFWM_BAR_FOREGROUND_ACTIVE;
-  acvs[1] = TFWM_BAR_BACKGROUND_ACTIVE;
+  acvs[0] = core.cfg->bar_foreground_active;
+  acvs[1] = core.cfg->bar_background_active;
   acvs[2] = core.font;
   xcb_create_gc(
       core.c,
       core.gc_active,
-      core.bar,
+      core.sc->root,
       XCB_GC_FOREGROUND | XCB_GC_BACKGROUND | XCB_GC_FONT,
       acvs
   );
 
   core.gc_inactive = xcb_generate_id(core.c);
   uint32_t invs[3];
-  invs[0] = TFWM_BAR_FOREGROUND;
-  invs[1] = TFWM_BAR_BACKGROUND;
+  invs[0] = core.cfg->bar_foreground;
+  invs[1] = core.cfg->bar_background;
   invs[2] = core.font;
   xcb_create_gc(
       core.c,
       core.gc_inactive,
-      core.bar,
+      core.sc->root,
       XCB_GC_FOREGROUND | XCB_GC_BACKGROUND | XCB_GC_FONT,
       invs
   );
 
+  core.gc_background = xcb_generate_id(core.c);
+  uint32_t bgvs[1] = {core.cfg->bar_background};
+  xcb_create_gc(
+      core.c, core.gc_background, core.sc->root, XCB_GC_FOREGROUND, bgvs
+  );
+  tfwm_output_init();
+  core.bar_dirty = TFWM_BAR_ALL;
+
   tfwm_ewmh();
-  xcb_flush(core.c);
+  tfwm_loop_init();
+  tfwm_config_watch();
+  core.loop.clock = tfwm_loop_timer(TFWM_BAR_CLOCK_INTERVAL, tfwm_bar_tick);
+  tfwm_bar_tick(-1, 0);
+  tfwm_ipc_init();
+  tfwm_adopt_scan(in.tree, in.session);
 }
 
 int main(int argc, char *argv[]) {
   core = (tfwm_xcb_t){0};
+  core.ipc.fd = -1;
+  core.loop.fd = -1;
+  core.loop.sig = -1;
+  core.loop.clock = -1;
+  core.journal.fd = -1;
+  core.log.fd = -1;
 
   if ((2 == argc) && (strcmp("-v", argv[1]) == 0)) {
     printf("tfwm-0.0.1, Copyright (c) 2024 Raihan Rahardyan, MIT License\n");
     return EXIT_SUCCESS;
   }
 
+  if ((2 == argc) && (strcmp("-c", argv[1]) == 0)) {
+    return tfwm_ipc_client();
+  }
+
   if (argc != 1) {
-    printf("usage: tfwm [-v]\n");
+    printf("usage: tfwm [-v] [-c]\n");
     return EXIT_SUCCESS;
   }
 
+  tfwm_log_init();
   core.c = xcb_connect(NULL, NULL);
   core.exit = xcb_connection_has_error(core.c);
   if (core.exit > 0) {
@@ -1270,15 +3805,46 @@ int main(int argc, char *argv[]) {
   }
 
   core.sc = xcb_setup_roots_iterator(xcb_get_setup(core.c)).data;
+  core.root_w = core.sc->width_in_pixels;
+  core.root_h = core.sc->height_in_pixels;
   tfwm_init();
 
-  while (core.exit == EXIT_SUCCESS) {
+  while ((core.exit == EXIT_SUCCESS) && !core.quit) {
     core.exit = tfwm_handle_event();
-
-    if (core.sc) {
-      tfwm_bar();
+    if (core.quit) {
+      break;
     }
-  }
 
+    tfwm_drag_apply();
+    if (core.out_dirty) {
+      tfwm_output_update();
+      tfwm_ewmh_workarea();
+    }
+    tfwm_bar();
+    if (core.stats.dump) {
+      tfwm_stats_dump();
+    }
+    tfwm_stats_flush();
+    tfwm_ipc_reply();
+  }
+
+  tfwm_trace_stop(NULL);
+  tfwm_ipc_cleanup();
+  tfwm_loop_cleanup();
+  if (core.restart) {
+    tfwm_journal_release();
+  }
+  tfwm_journal_cleanup();
+  tfwm_config_cleanup();
+  tfwm_util_cleanup();
+  xcb_disconnect(core.c);
+  if (core.restart) {
+    TFWM_LOG(TFWM_LOG_INFO, TFWM_SYS_CORE, "restarting %s", argv[0]);
+    tfwm_log_drain();
+    execvp(argv[0], argv);
+    TFWM_LOG(TFWM_LOG_ERROR, TFWM_SYS_CORE, "can not restart %s", argv[0]);
+    core.exit = EXIT_FAILURE;
+  }
+  tfwm_log_cleanup();
   return core.exit;
 }
@@ -1,10 +1,145 @@
 #ifndef TFWM_H
 #define TFWM_H
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <sys/types.h>
+#include <xcb/randr.h>
+#include <xcb/xcb_keysyms.h>
 #include <xcb/xproto.h>
 
 #define ARRAY_LENGTH(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+#ifndef TFWM_LOG_LEVEL
+#define TFWM_LOG_LEVEL 3
+#endif
+
+#define TFWM_LOG(lvl, sys, ...)                                     \
+  do {                                                              \
+    if (((lvl) <= TFWM_LOG_LEVEL) && ((lvl) <= core.log.level)) {   \
+      tfwm_log_write((lvl), (sys), __VA_ARGS__);                    \
+    }                                                               \
+  } while (0)
+
+enum {
+  TFWM_BAR_WORKSPACE = 1 << 0,
+  TFWM_BAR_LAYOUT = 1 << 1,
+  TFWM_BAR_TABS = 1 << 2,
+  TFWM_BAR_INFO = 1 << 3,
+  TFWM_BAR_ALL = (1 << 4) - 1,
+};
+
+enum {
+  TFWM_ATOM_NET_SUPPORTED,
+  TFWM_ATOM_NET_WM_NAME,
+  TFWM_ATOM_NET_WM_STATE,
+  TFWM_ATOM_NET_WM_WINDOW_TYPE,
+  TFWM_ATOM_NET_WM_WINDOW_TYPE_DOCK,
+  TFWM_ATOM_NET_WM_PID,
+  TFWM_ATOM_NET_ACTIVE_WINDOW,
+  TFWM_ATOM_NET_DESKTOP_VIEWPORT,
+  TFWM_ATOM_NET_CURRENT_DESKTOP,
+  TFWM_ATOM_NET_WORKAREA,
+  TFWM_ATOM_NET_SUPPORTING_WM_CHECK,
+  TFWM_ATOM_TFWM_STATS,
+  TFWM_ATOM_TFWM_STATS_REQUEST,
+  TFWM_ATOM_TFWM_SESSION,
+  TFWM_ATOM_LEN,
+};
+
+enum {
+  TFWM_LOG_ERROR,
+  TFWM_LOG_WARN,
+  TFWM_LOG_INFO,
+  TFWM_LOG_DEBUG,
+  TFWM_LOG_LEN,
+};
+
+enum {
+  TFWM_SYS_CORE,
+  TFWM_SYS_KEYBOARD,
+  TFWM_SYS_WINDOW,
+  TFWM_SYS_JOURNAL,
+  TFWM_SYS_LAUNCH,
+  TFWM_SYS_LOOP,
+  TFWM_SYS_IPC,
+  TFWM_SYS_CONFIG,
+  TFWM_SYS_LEN,
+};
+
+enum {
+  TFWM_LOG_RING = 256,
+  TFWM_LOG_MSG = 118,
+  TFWM_LOG_BATCH = 32,
+};
+
+enum {
+  TFWM_TRACE_EVENT,
+  TFWM_TRACE_LAYOUT,
+  TFWM_TRACE_BAR,
+  TFWM_TRACE_WAIT,
+  TFWM_TRACE_LEN,
+};
+
+enum {
+  TFWM_TRACE_SPANS = 1 << 18,
+};
+
+enum {
+  TFWM_CSR_DEFAULT,
+  TFWM_CSR_MOVE,
+  TFWM_CSR_RESIZE,
+  TFWM_CSR_LEN,
+};
+
+enum {
+  TFWM_STAT_RT_ATOM,
+  TFWM_STAT_RT_FONT,
+  TFWM_STAT_RT_TEXT_EXTENTS,
+  TFWM_STAT_RT_KEYBOARD,
+  TFWM_STAT_RT_CURSOR,
+  TFWM_STAT_RT_MAP_REQUEST,
+  TFWM_STAT_RT_OUTPUT,
+  TFWM_STAT_RT_ADOPT,
+  TFWM_STAT_RT_LEN,
+};
+
+enum {
+  TFWM_STATS_BUCKETS = 16,
+};
+
+enum {
+  TFWM_IPC_CLIENTS = 8,
+  TFWM_IPC_ARGS = 32,
+};
+
+enum {
+  TFWM_DISPLAY_LEN = 64,
+};
+
+enum {
+  TFWM_JOURNAL_WINDOWS = 1024,
+  TFWM_JOURNAL_WORKSPACES = 32,
+};
+
+enum {
+  TFWM_LOOP_EVENTS = 32,
+  TFWM_CLOCK_LEN = 64,
+};
+
+enum {
+  TFWM_PROP_CLASS,
+  TFWM_PROP_NAME,
+  TFWM_PROP_NORMAL_HINTS,
+  TFWM_PROP_WINDOW_TYPE,
+  TFWM_PROP_TRANSIENT_FOR,
+  TFWM_PROP_PID,
+  TFWM_PROP_LEN,
+};
 
 enum {
   TFWM_LAYOUT_TILING,
@@ -12,14 +147,24 @@ enum {
   TFWM_LAYOUT_WINDOW,
 };
 
+typedef uint32_t tfwm_handle_t;
+
 typedef struct {
   uint8_t is_fullscreen;
+  uint32_t gen;
+  uint32_t wsid;
+  tfwm_handle_t prev;
+  tfwm_handle_t next;
   int x;
   int y;
   int w;
   int h;
   int b;
+  int cw;
+  int ch;
+  uint32_t slot;
   xcb_window_t win;
+  xcb_window_t frame;
   char *class;
 } tfwm_window_t;
 
@@ -28,14 +173,50 @@ typedef struct {
   char *sym;
 } tfwm_layout_t;
 
+typedef struct {
+  int x;
+  int y;
+  int w;
+  int h;
+} tfwm_geometry_t;
+
+typedef struct {
+  uint32_t cap;
+  tfwm_geometry_t *list;
+} tfwm_scratch_t;
+
+typedef struct {
+  uint32_t len;
+  uint32_t cap;
+  tfwm_handle_t free;
+  tfwm_window_t *list;
+} tfwm_arena_t;
+
 typedef struct {
   uint16_t layout;
   uint32_t win_len;
-  uint32_t win_cap;
   const char *name;
-  tfwm_window_t *win_list;
+  tfwm_handle_t head;
+  tfwm_handle_t tail;
+  tfwm_handle_t focus;
+  xcb_window_t container;
+  uint8_t raised;
+  uint32_t out;
+  tfwm_geometry_t geom;
 } tfwm_workspace_t;
 
+typedef struct {
+  xcb_atom_t name;
+  uint32_t wsid;
+  tfwm_geometry_t geom;
+  xcb_window_t bar;
+  xcb_pixmap_t bar_pm;
+  int bar_l;
+  int bar_r;
+  int bar_tabs_l;
+  int bar_tabs_r;
+} tfwm_output_t;
+
 typedef struct {
   uint16_t mod;
   xcb_keysym_t keysym;
@@ -44,41 +225,356 @@ typedef struct {
 } tfwm_keybind_t;
 
 typedef struct {
-  uint32_t req;
-  void (*func)(xcb_generic_event_t *evt);
-} tfwm_event_handler_t;
+  uint32_t border_active;
+  uint32_t border_inactive;
+  uint32_t frame_background;
+  uint32_t bar_foreground;
+  uint32_t bar_background;
+  uint32_t bar_foreground_active;
+  uint32_t bar_background_active;
+  double tile_master;
+  uint32_t key_len;
+  const tfwm_keybind_t *keys;
+  tfwm_keybind_t *key_buf;
+  uint32_t arg_len;
+  const char **args;
+  char *text;
+} tfwm_config_t;
+
+typedef struct {
+  const char *name;
+  size_t offset;
+} tfwm_config_option_t;
+
+typedef struct {
+  const char *name;
+  uint32_t value;
+} tfwm_config_name_t;
+
+typedef struct {
+  xcb_window_t win;
+  tfwm_handle_t handle;
+} tfwm_index_entry_t;
+
+typedef struct {
+  uint32_t len;
+  uint32_t cap;
+  tfwm_index_entry_t *list;
+} tfwm_index_t;
+
+typedef struct {
+  xcb_window_t win;
+  uint8_t adopt;
+  uint32_t slot;
+  uint32_t done;
+  xcb_get_property_cookie_t ck[TFWM_PROP_LEN];
+  xcb_get_property_reply_t *r[TFWM_PROP_LEN];
+  xcb_get_window_attributes_cookie_t attr_ck;
+  xcb_get_window_attributes_reply_t *attr;
+  xcb_get_geometry_cookie_t geom_ck;
+  xcb_get_geometry_reply_t *geom;
+} tfwm_pending_t;
+
+typedef struct {
+  uint32_t len;
+  uint32_t cap;
+  uint32_t adopt;
+  tfwm_pending_t *list;
+} tfwm_pending_queue_t;
+
+typedef struct {
+  xcb_window_t win;
+  uint32_t wsid;
+  uint32_t pos;
+  int32_t x;
+  int32_t y;
+  int32_t w;
+  int32_t h;
+  int32_t cw;
+  int32_t ch;
+} tfwm_journal_entry_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t size;
+  uint32_t session;
+  uint32_t cur_ws;
+  uint16_t layout[TFWM_JOURNAL_WORKSPACES];
+  tfwm_journal_entry_t list[TFWM_JOURNAL_WINDOWS];
+} tfwm_journal_file_t;
+
+typedef struct {
+  int fd;
+  uint32_t next;
+  tfwm_journal_file_t *map;
+} tfwm_journal_t;
+
+typedef struct {
+  pid_t pid;
+  uint32_t wsid;
+  uint64_t t;
+} tfwm_launch_t;
+
+typedef struct {
+  pid_t last;
+  uint32_t len;
+  uint32_t cap;
+  tfwm_launch_t *list;
+} tfwm_launch_queue_t;
+
+typedef struct {
+  uint8_t pending;
+  xcb_window_t win;
+  int x;
+  int y;
+  int w;
+  int h;
+  int ptr_x;
+  int ptr_y;
+} tfwm_drag_t;
+
+typedef struct {
+  volatile sig_atomic_t dump;
+  uint8_t req_on;
+  unsigned int seq;
+  unsigned long long flush;
+  unsigned long long req;
+  uint32_t req_max;
+  unsigned long long rt[TFWM_STAT_RT_LEN];
+  unsigned long long evt[256];
+  uint32_t hist[256][TFWM_STATS_BUCKETS];
+  unsigned long long launch;
+  uint32_t launch_hist[TFWM_STATS_BUCKETS];
+  unsigned long long start;
+} tfwm_stats_t;
+
+typedef struct {
+  uint64_t ts;
+  uint32_t dur;
+  uint32_t win;
+  uint16_t id;
+  uint8_t kind;
+} tfwm_trace_span_t;
+
+typedef struct {
+  uint64_t head;
+  tfwm_trace_span_t *list;
+} tfwm_trace_t;
+
+typedef struct {
+  const char *name;
+  void (*func)(char **cmd);
+  int argc;
+} tfwm_command_t;
+
+typedef struct {
+  int fd;
+  void (*func)(int fd, uint32_t events);
+} tfwm_source_t;
+
+typedef struct {
+  int fd;
+  int sig;
+  int clock;
+  uint32_t len;
+  uint32_t cap;
+  tfwm_source_t *list;
+} tfwm_loop_t;
+
+typedef struct {
+  int fd;
+  int done;
+  int overflow;
+  int wait;
+  size_t len;
+  size_t cap;
+  char *buf;
+  size_t reply_len;
+  size_t sent;
+  char *reply;
+} tfwm_ipc_client_t;
+
+typedef struct {
+  int fd;
+  uint32_t len;
+  tfwm_ipc_client_t list[TFWM_IPC_CLIENTS];
+} tfwm_ipc_t;
+
+typedef struct {
+  uint64_t t;
+  uint8_t level;
+  uint8_t sys;
+  char msg[TFWM_LOG_MSG];
+} tfwm_log_record_t;
+
+typedef struct {
+  int fd;
+  int level;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t lost;
+  int64_t epoch;
+  tfwm_log_record_t ring[TFWM_LOG_RING];
+} tfwm_log_t;
+
+typedef struct {
+  xcb_intern_atom_cookie_t atom[TFWM_ATOM_LEN];
+  xcb_query_font_cookie_t font;
+  xcb_get_modifier_mapping_cookie_t modmap;
+  xcb_query_tree_cookie_t tree;
+  xcb_get_property_cookie_t session;
+} tfwm_init_t;
+
+typedef struct {
+  xcb_key_symbols_t *syms;
+  uint16_t lock_mask;
+  uint16_t bind[256][256];
+} tfwm_keyboard_t;
 
 typedef struct {
   xcb_connection_t *c;
   xcb_screen_t *sc;
+  uint16_t root_w;
+  uint16_t root_h;
   xcb_window_t win;
-  xcb_window_t bar;
   xcb_font_t font;
+  int16_t font_adv[256];
   xcb_gcontext_t gc_active;
   xcb_gcontext_t gc_inactive;
-  int bar_l;
-  int bar_r;
+  xcb_gcontext_t gc_background;
+  xcb_cursor_t cursor[TFWM_CSR_LEN];
+  uint32_t bar_dirty;
   int ptr_x;
   int ptr_y;
   int exit;
+  int quit;
+  int restart;
   uint32_t cur_btn;
-  uint32_t cur_win;
+  tfwm_handle_t cur_win;
   uint32_t cur_ws;
   uint32_t prv_ws;
   uint32_t ws_len;
   tfwm_workspace_t *ws_list;
+  uint8_t randr;
+  uint8_t out_dirty;
+  uint32_t cur_out;
+  uint32_t out_len;
+  tfwm_output_t *out_list;
+  tfwm_arena_t arena;
+  tfwm_index_t index;
+  tfwm_pending_queue_t pending;
+  tfwm_launch_queue_t launch;
+  tfwm_journal_t journal;
+  tfwm_scratch_t scratch;
+  tfwm_keyboard_t kbd;
+  tfwm_config_t *cfg;
+  int cfg_fd;
+  tfwm_drag_t drag;
+  xcb_atom_t atom[TFWM_ATOM_LEN];
+  tfwm_stats_t stats;
+  tfwm_ipc_t ipc;
+  tfwm_loop_t loop;
+  tfwm_log_t log;
+  tfwm_trace_t trace;
+  char clock[TFWM_CLOCK_LEN];
 } tfwm_xcb_t;
 
-static void tfwm_util_log(char *log, int exit);
-static xcb_keycode_t *tfwm_util_keycodes(xcb_keysym_t keysym);
-static xcb_keysym_t tfwm_util_keysym(xcb_keycode_t keycode);
-static xcb_cursor_t tfwm_util_cursor(char *name);
-static xcb_atom_t tfwm_util_atom(char *name);
-static char *tfwm_util_window_class(xcb_window_t window);
+static void tfwm_log_init(void);
+static void tfwm_log_write(int level, int sys, const char *fmt, ...);
+static void tfwm_log_drain(void);
+static void tfwm_log_cleanup(void);
+
+static void tfwm_util_cursors(void);
+static void tfwm_util_atoms(xcb_intern_atom_cookie_t *ck);
+static char *tfwm_util_prop_string(xcb_get_property_reply_t *p, int skip);
+static void tfwm_util_font_metrics(xcb_query_font_cookie_t ck);
+static int tfwm_util_text_extents(char *text);
 static int tfwm_util_text_width(char *text);
+static void tfwm_util_display(char *buf, size_t n);
 static void tfwm_util_cleanup(void);
 
+static uint64_t tfwm_stats_now(void);
+static uint64_t tfwm_stats_roundtrip(int site);
+static void tfwm_stats_latency(uint32_t *hist, uint64_t us);
+static void tfwm_stats_flush(void);
+static char *tfwm_stats_snapshot(void);
+static void tfwm_stats_dump(void);
+
+static uint64_t tfwm_trace_begin(void);
+static void tfwm_trace_end(int kind, uint32_t id, uint64_t t, uint32_t win);
+static uint32_t tfwm_trace_window(xcb_generic_event_t *event);
+static const char *tfwm_trace_name(tfwm_trace_span_t *s);
+static void tfwm_trace_write(void);
+
+static void tfwm_loop_init(void);
+static int tfwm_loop_add(int fd, uint32_t events, void (*func)(int, uint32_t));
+static void tfwm_loop_del(int fd);
+static int tfwm_loop_timer(uint32_t ms, void (*func)(int, uint32_t));
+static void tfwm_loop_signal(int fd, uint32_t events);
+static void tfwm_loop_cleanup(void);
+
+static int tfwm_ipc_path(char *buf, size_t n);
+static void tfwm_ipc_init(void);
+static void tfwm_ipc_accept(int fd, uint32_t events);
+static void tfwm_ipc_event(int fd, uint32_t events);
+static int tfwm_ipc_read(tfwm_ipc_client_t *cl);
+static void tfwm_ipc_exec(tfwm_ipc_client_t *cl);
+static int tfwm_ipc_send(tfwm_ipc_client_t *cl);
+static void tfwm_ipc_write(int fd, uint32_t events);
+static void tfwm_ipc_reply(void);
+static void tfwm_ipc_cleanup(void);
+static int tfwm_ipc_client(void);
+
+static tfwm_window_t *tfwm_arena_get(tfwm_handle_t handle);
+static tfwm_handle_t tfwm_arena_alloc(void);
+static void tfwm_arena_free(tfwm_handle_t handle);
+
+static uint32_t tfwm_index_hash(xcb_window_t window);
+static tfwm_index_entry_t *tfwm_index_find(xcb_window_t window);
+static tfwm_handle_t tfwm_index_get(xcb_window_t window);
+static void tfwm_index_grow(void);
+static void tfwm_index_put(xcb_window_t window, tfwm_handle_t handle);
+static void tfwm_index_del(xcb_window_t window);
+
+static uint16_t tfwm_keyboard_clean_mask(uint16_t state);
+static void tfwm_keyboard_lock_mask(xcb_get_modifier_mapping_cookie_t ck);
+static void tfwm_keyboard_grab_key(int kc, int mod, int grab);
+static void tfwm_keyboard_grab(void);
+static void tfwm_keyboard_regrab(uint16_t (*old)[256]);
+static void tfwm_keyboard_map(void);
+static void tfwm_keyboard_load(xcb_get_modifier_mapping_cookie_t ck);
+
+static void tfwm_config_default(tfwm_config_t *cfg);
+static char *tfwm_config_path(void);
+static int tfwm_config_key(char *s, uint16_t *mod, xcb_keysym_t *keysym);
+static int tfwm_config_bind(tfwm_config_t *cfg, char **save);
+static int tfwm_config_line(tfwm_config_t *cfg, char *line);
+static tfwm_config_t *tfwm_config_parse(const char *path);
+static void tfwm_config_free(tfwm_config_t *cfg);
+static void tfwm_config_apply(tfwm_config_t *cfg);
+static void tfwm_config_load(void);
+static void tfwm_config_watch(void);
+static void tfwm_config_signal(int fd, uint32_t events);
+static void tfwm_config_cleanup(void);
+
+static void tfwm_journal_open(void);
+static tfwm_journal_entry_t *tfwm_journal_entry(tfwm_window_t *w);
+static void tfwm_journal_window(tfwm_window_t *w);
+static void tfwm_journal_forget(tfwm_window_t *w);
+static void tfwm_journal_workspace(uint32_t wsid);
+static int tfwm_journal_compare(const void *a, const void *b);
+static int tfwm_journal_compare_window(const void *a, const void *b);
+static void tfwm_journal_session(xcb_get_property_reply_t *r);
+static uint32_t tfwm_journal_order(xcb_window_t *children, int n, uint32_t *order);
+static void tfwm_journal_release(void);
+static void tfwm_journal_cleanup(void);
+
 void tfwm_exit(char **cmd);
+void tfwm_restart(char **cmd);
+void tfwm_log_level(char **cmd);
+void tfwm_trace_start(char **cmd);
+void tfwm_trace_stop(char **cmd);
+void tfwm_config_reload(char **cmd);
 
 void tfwm_window_spawn(char **cmd);
 void tfwm_window_kill(char **cmd);
@@ -98,21 +594,52 @@ void tfwm_workspace_use_window(char **cmd);
 
 static void tfwm_window_focus(xcb_window_t window);
 static void tfwm_window_color(xcb_window_t window, uint32_t color);
-static void tfwm_window_move(xcb_window_t window, int x, int y);
-static void tfwm_window_resize(xcb_window_t window, int w, int h);
+static void tfwm_window_configure(xcb_window_t window, int x, int y, int w, int h);
 static void tfwm_window_set_attr(xcb_window_t window, int x, int y, int w, int h);
+static void tfwm_window_unmanage(xcb_window_t window);
 
-static void tfwm_workspace_window_unmap(uint32_t wsid);
-static void tfwm_workspace_window_map(uint32_t wsid);
-static void tfwm_workspace_window_malloc(uint32_t wsid);
-static void tfwm_workspace_window_realloc(uint32_t wsid);
-static void tfwm_workspace_window_append(uint32_t wsid, tfwm_window_t window);
-static void tfwm_workspace_window_pop(uint32_t wid);
+static void tfwm_workspace_activate(uint32_t wsid);
+static void tfwm_workspace_container(uint32_t wsid);
+static void tfwm_workspace_restack(uint32_t wsid);
+static int tfwm_workspace_visible(uint32_t wsid);
+static void tfwm_workspace_place(uint32_t wsid, uint32_t oid);
 
+static uint32_t tfwm_output_query(tfwm_output_t **list);
+static void tfwm_output_bar(tfwm_output_t *o);
+static void tfwm_output_bar_free(tfwm_output_t *o);
+static void tfwm_output_init(void);
+static void tfwm_output_update(void);
+static void tfwm_workspace_window_insert(
+    uint32_t wsid, tfwm_handle_t handle, tfwm_handle_t after
+);
+static void tfwm_workspace_window_append(uint32_t wsid, tfwm_handle_t handle);
+static void tfwm_workspace_window_pop(tfwm_handle_t handle);
+
+static tfwm_geometry_t *tfwm_layout_scratch(uint32_t len);
+static void tfwm_layout_commit(uint32_t wsid);
 static void tfwm_layout_apply_tiling(uint32_t wsid);
 static void tfwm_layout_apply_window(uint32_t wsid);
 static void tfwm_layout_update(uint32_t wsid);
 
+static pid_t tfwm_launch(char **cmd);
+static int tfwm_launch_take(pid_t pid, uint32_t *wsid);
+static void tfwm_launch_reap(pid_t pid);
+
+static void tfwm_drag_apply(void);
+
+static tfwm_pending_t *tfwm_map_begin(xcb_window_t window);
+static void tfwm_map_cancel(xcb_window_t window);
+static int tfwm_map_poll(tfwm_pending_t *p);
+static void tfwm_map_finish(tfwm_pending_t *p);
+static void tfwm_map_complete(void);
+
+static void tfwm_adopt_scan(
+    xcb_query_tree_cookie_t tck, xcb_get_property_cookie_t sck
+);
+static void tfwm_adopt_begin(xcb_window_t window, uint32_t slot);
+static uint32_t tfwm_adopt_workspace(int x, int y);
+static void tfwm_adopt_settle(void);
+
 void tfwm_handle_keypress(xcb_generic_event_t *event);
 void tfwm_handle_map_request(xcb_generic_event_t *event);
 void tfwm_handle_focus_in(xcb_generic_event_t *event);
@@ -121,18 +648,39 @@ void tfwm_handle_enter_notify(xcb_generic_event_t *event);
 void tfwm_handle_leave_notify(xcb_generic_event_t *event);
 void tfwm_handle_motion_notify(xcb_generic_event_t *event);
 void tfwm_handle_destroy_notify(xcb_generic_event_t *event);
+void tfwm_handle_unmap_notify(xcb_generic_event_t *event);
 void tfwm_handle_button_press(xcb_generic_event_t *event);
 void tfwm_handle_button_release(xcb_generic_event_t *event);
+void tfwm_handle_mapping_notify(xcb_generic_event_t *event);
+void tfwm_handle_expose(xcb_generic_event_t *event);
+void tfwm_handle_property_notify(xcb_generic_event_t *event);
+void tfwm_handle_screen_change(xcb_generic_event_t *event);
 
+static void tfwm_handle_dispatch(xcb_generic_event_t *event);
+static xcb_generic_event_t *tfwm_handle_wait(void);
 static int tfwm_handle_event(void);
 
-static void tfwm_bar_render_left(xcb_gcontext_t gc, char *text);
-static void tfwm_bar_render_right(xcb_gcontext_t gc, char *text);
-static void tfwm_bar_module_layout(void (*render)(xcb_gcontext_t, char *));
-static void tfwm_bar_module_separator(void (*render)(xcb_gcontext_t, char *));
-static void tfwm_bar_module_workspace(void (*render)(xcb_gcontext_t, char *));
-static void tfwm_bar_module_wm_info(void (*render)(xcb_gcontext_t, char *));
-static void tfwm_bar_module_window(void);
+static void tfwm_bar_render_left(tfwm_output_t *o, xcb_gcontext_t gc, char *text);
+static void tfwm_bar_render_right(tfwm_output_t *o, xcb_gcontext_t gc, char *text);
+static void tfwm_bar_module_layout(
+    tfwm_output_t *o, void (*render)(tfwm_output_t *, xcb_gcontext_t, char *)
+);
+static void tfwm_bar_module_separator(
+    tfwm_output_t *o, void (*render)(tfwm_output_t *, xcb_gcontext_t, char *)
+);
+static void tfwm_bar_module_workspace(
+    tfwm_output_t *o, void (*render)(tfwm_output_t *, xcb_gcontext_t, char *)
+);
+static void tfwm_bar_module_wm_info(
+    tfwm_output_t *o, void (*render)(tfwm_output_t *, xcb_gcontext_t, char *)
+);
+static void tfwm_bar_module_clock(
+    tfwm_output_t *o, void (*render)(tfwm_output_t *, xcb_gcontext_t, char *)
+);
+static void tfwm_bar_module_window_tabs(tfwm_output_t *o);
+static void tfwm_bar_clear(tfwm_output_t *o, int x, int w);
+static void tfwm_bar_tick(int fd, uint32_t events);
+static void tfwm_bar_draw(tfwm_output_t *o);
 static void tfwm_bar(void);
 
 static void tfwm_ewmh_supported(void);
@@ -142,30 +690,183 @@ static void tfwm_ewmh_workarea();
 static void tfwm_ewmh_supporting_wm_check(xcb_window_t wid);
 static void tfwm_ewmh(void);
 
+static void tfwm_init_request(tfwm_init_t *in);
 static void tfwm_init(void);
 
-static tfwm_event_handler_t event_handlers[] = {
-    {XCB_KEY_PRESS, tfwm_handle_keypress},
-    {XCB_MAP_REQUEST, tfwm_handle_map_request},
-    {XCB_FOCUS_IN, tfwm_handle_focus_in},
-    {XCB_FOCUS_OUT, tfwm_handle_focus_out},
-    {XCB_ENTER_NOTIFY, tfwm_handle_enter_notify},
-    {XCB_LEAVE_NOTIFY, tfwm_handle_leave_notify},
-    {XCB_MOTION_NOTIFY, tfwm_handle_motion_notify},
-    {XCB_DESTROY_NOTIFY, tfwm_handle_destroy_notify},
-    {XCB_BUTTON_PRESS, tfwm_handle_button_press},
-    {XCB_BUTTON_RELEASE, tfwm_handle_button_release},
-    {XCB_NONE, NULL},
-};
-static const int TFWM_WIN_LIST_ALLOC = 5;
+static void (*event_handlers[256])(xcb_generic_event_t *event) = {
+    [XCB_KEY_PRESS] = tfwm_handle_keypress,
+    [XCB_MAP_REQUEST] = tfwm_handle_map_request,
+    [XCB_FOCUS_IN] = tfwm_handle_focus_in,
+    [XCB_FOCUS_OUT] = tfwm_handle_focus_out,
+    [XCB_ENTER_NOTIFY] = tfwm_handle_enter_notify,
+    [XCB_LEAVE_NOTIFY] = tfwm_handle_leave_notify,
+    [XCB_MOTION_NOTIFY] = tfwm_handle_motion_notify,
+    [XCB_DESTROY_NOTIFY] = tfwm_handle_destroy_notify,
+    [XCB_UNMAP_NOTIFY] = tfwm_handle_unmap_notify,
+    [XCB_BUTTON_PRESS] = tfwm_handle_button_press,
+    [XCB_BUTTON_RELEASE] = tfwm_handle_button_release,
+    [XCB_MAPPING_NOTIFY] = tfwm_handle_mapping_notify,
+    [XCB_EXPOSE] = tfwm_handle_expose,
+    [XCB_PROPERTY_NOTIFY] = tfwm_handle_property_notify,
+};
+static const char *TFWM_EVENT_NAME[256] = {
+    [XCB_KEY_PRESS] = "key_press",
+    [XCB_MAP_REQUEST] = "map_request",
+    [XCB_FOCUS_IN] = "focus_in",
+    [XCB_FOCUS_OUT] = "focus_out",
+    [XCB_ENTER_NOTIFY] = "enter_notify",
+    [XCB_LEAVE_NOTIFY] = "leave_notify",
+    [XCB_MOTION_NOTIFY] = "motion_notify",
+    [XCB_DESTROY_NOTIFY] = "destroy_notify",
+    [XCB_UNMAP_NOTIFY] = "unmap_notify",
+    [XCB_BUTTON_PRESS] = "button_press",
+    [XCB_BUTTON_RELEASE] = "button_release",
+    [XCB_MAPPING_NOTIFY] = "mapping_notify",
+    [XCB_EXPOSE] = "expose",
+    [XCB_PROPERTY_NOTIFY] = "property_notify",
+};
+static const char *TFWM_STAT_RT_NAME[TFWM_STAT_RT_LEN] = {
+    [TFWM_STAT_RT_ATOM] = "tfwm_util_atoms",
+    [TFWM_STAT_RT_FONT] = "tfwm_util_font_metrics",
+    [TFWM_STAT_RT_TEXT_EXTENTS] = "tfwm_util_text_extents",
+    [TFWM_STAT_RT_KEYBOARD] = "tfwm_keyboard_load",
+    [TFWM_STAT_RT_CURSOR] = "tfwm_util_cursors",
+    [TFWM_STAT_RT_MAP_REQUEST] = "tfwm_map_complete",
+    [TFWM_STAT_RT_OUTPUT] = "tfwm_output_query",
+    [TFWM_STAT_RT_ADOPT] = "tfwm_adopt_scan",
+};
+static const int TFWM_ARENA_ALLOC = 16;
+static const int TFWM_HANDLE_SLOT_BITS = 20;
+static const uint32_t TFWM_HANDLE_SLOT_MASK = (1u << 20) - 1;
+static const int TFWM_INDEX_ALLOC = 64;
+static const int TFWM_PENDING_ALLOC = 8;
+static const int TFWM_LOOP_ALLOC = 16;
+static const int TFWM_LAUNCH_ALLOC = 8;
+static const uint32_t TFWM_JOURNAL_MAGIC = 0x6d776674;
+static const uint32_t TFWM_SIZE_HINT_US_SIZE = 1 << 1;
+static const uint32_t TFWM_SIZE_HINT_P_SIZE = 1 << 3;
+static const uint32_t TFWM_SIZE_HINT_P_MIN_SIZE = 1 << 4;
+static const xcb_keysym_t TFWM_KEYSYM_NUM_LOCK = 0xff7f;
+static const xcb_keysym_t TFWM_KEYSYM_SCROLL_LOCK = 0xff14;
+static const size_t TFWM_IPC_ALLOC = 1024;
+static const size_t TFWM_IPC_MAX = 1 << 20;
+static const char *TFWM_IPC_DELIM = "\n;";
+static const char *TFWM_LOG_NAME[TFWM_LOG_LEN] = {
+    [TFWM_LOG_ERROR] = "error",
+    [TFWM_LOG_WARN] = "warn",
+    [TFWM_LOG_INFO] = "info",
+    [TFWM_LOG_DEBUG] = "debug",
+};
+static const char *TFWM_TRACE_CATEGORY[TFWM_TRACE_LEN] = {
+    [TFWM_TRACE_EVENT] = "event",
+    [TFWM_TRACE_LAYOUT] = "layout",
+    [TFWM_TRACE_BAR] = "bar",
+    [TFWM_TRACE_WAIT] = "wait",
+};
+static const char *TFWM_SYS_NAME[TFWM_SYS_LEN] = {
+    [TFWM_SYS_CORE] = "core",
+    [TFWM_SYS_KEYBOARD] = "keyboard",
+    [TFWM_SYS_WINDOW] = "window",
+    [TFWM_SYS_JOURNAL] = "journal",
+    [TFWM_SYS_LAUNCH] = "launch",
+    [TFWM_SYS_LOOP] = "loop",
+    [TFWM_SYS_IPC] = "ipc",
+    [TFWM_SYS_CONFIG] = "config",
+};
 static const char *TFWM_NAME = "tfwm";
 static const char *TFWM_VERSION = "0.0.1";
-static const char *TFWM_SUPPORTED_ATOM[] = {
-    "_NET_WM_NAME",
-    "_NET_WM_STATE",
-    "_NET_WM_WINDOW_TYPE",
-    "_NET_ACTIVE_WINDOW",
-    "_NET_SUPPORTED",
+static const char *TFWM_ATOM_NAME[TFWM_ATOM_LEN] = {
+    [TFWM_ATOM_NET_SUPPORTED] = "_NET_SUPPORTED",
+    [TFWM_ATOM_NET_WM_NAME] = "_NET_WM_NAME",
+    [TFWM_ATOM_NET_WM_STATE] = "_NET_WM_STATE",
+    [TFWM_ATOM_NET_WM_WINDOW_TYPE] = "_NET_WM_WINDOW_TYPE",
+    [TFWM_ATOM_NET_WM_WINDOW_TYPE_DOCK] = "_NET_WM_WINDOW_TYPE_DOCK",
+    [TFWM_ATOM_NET_WM_PID] = "_NET_WM_PID",
+    [TFWM_ATOM_NET_ACTIVE_WINDOW] = "_NET_ACTIVE_WINDOW",
+    [TFWM_ATOM_NET_DESKTOP_VIEWPORT] = "_NET_DESKTOP_VIEWPORT",
+    [TFWM_ATOM_NET_CURRENT_DESKTOP] = "_NET_CURRENT_DESKTOP",
+    [TFWM_ATOM_NET_WORKAREA] = "_NET_WORKAREA",
+    [TFWM_ATOM_NET_SUPPORTING_WM_CHECK] = "_NET_SUPPORTING_WM_CHECK",
+    [TFWM_ATOM_TFWM_STATS] = "_TFWM_STATS",
+    [TFWM_ATOM_TFWM_STATS_REQUEST] = "_TFWM_STATS_REQUEST",
+    [TFWM_ATOM_TFWM_SESSION] = "_TFWM_SESSION",
+};
+static const int TFWM_SUPPORTED_ATOM[] = {
+    TFWM_ATOM_NET_WM_NAME,
+    TFWM_ATOM_NET_WM_STATE,
+    TFWM_ATOM_NET_WM_WINDOW_TYPE,
+    TFWM_ATOM_NET_ACTIVE_WINDOW,
+    TFWM_ATOM_NET_SUPPORTED,
+};
+
+static const tfwm_config_option_t TFWM_CONFIG_COLOR[] = {
+    {"border_active", offsetof(tfwm_config_t, border_active)},
+    {"border_inactive", offsetof(tfwm_config_t, border_inactive)},
+    {"frame_background", offsetof(tfwm_config_t, frame_background)},
+    {"bar_foreground", offsetof(tfwm_config_t, bar_foreground)},
+    {"bar_background", offsetof(tfwm_config_t, bar_background)},
+    {"bar_foreground_active", offsetof(tfwm_config_t, bar_foreground_active)},
+    {"bar_background_active", offsetof(tfwm_config_t, bar_background_active)},
+};
+
+static const tfwm_config_name_t TFWM_CONFIG_MOD[] = {
+    {"Mod1", XCB_MOD_MASK_1},
+    {"Alt", XCB_MOD_MASK_1},
+    {"Mod4", XCB_MOD_MASK_4},
+    {"Super", XCB_MOD_MASK_4},
+    {"Shift", XCB_MOD_MASK_SHIFT},
+    {"Control", XCB_MOD_MASK_CONTROL},
+    {"Ctrl", XCB_MOD_MASK_CONTROL},
+};
+
+static const tfwm_config_name_t TFWM_CONFIG_KEYSYM[] = {
+    {"space", 0x0020},
+    {"apostrophe", 0x0027},
+    {"comma", 0x002c},
+    {"minus", 0x002d},
+    {"period", 0x002e},
+    {"slash", 0x002f},
+    {"semicolon", 0x003b},
+    {"equal", 0x003d},
+    {"bracketleft", 0x005b},
+    {"backslash", 0x005c},
+    {"bracketright", 0x005d},
+    {"grave", 0x0060},
+    {"BackSpace", 0xff08},
+    {"Tab", 0xff09},
+    {"Return", 0xff0d},
+    {"Escape", 0xff1b},
+    {"Home", 0xff50},
+    {"Left", 0xff51},
+    {"Up", 0xff52},
+    {"Right", 0xff53},
+    {"Down", 0xff54},
+    {"End", 0xff57},
+    {"Print", 0xff61},
+    {"Delete", 0xffff},
+};
+
+static const tfwm_command_t TFWM_COMMAND[] = {
+    {"exit", tfwm_exit, 0},
+    {"restart", tfwm_restart, 0},
+    {"log_level", tfwm_log_level, 1},
+    {"trace_start", tfwm_trace_start, 0},
+    {"trace_stop", tfwm_trace_stop, 0},
+    {"config_reload", tfwm_config_reload, 0},
+    {"window_spawn", tfwm_window_spawn, 1},
+    {"window_kill", tfwm_window_kill, 0},
+    {"window_next", tfwm_window_next, 0},
+    {"window_prev", tfwm_window_prev, 0},
+    {"window_swap_last", tfwm_window_swap_last, 0},
+    {"window_fullscreen", tfwm_window_fullscreen, 0},
+    {"window_to_workspace", tfwm_window_to_workspace, 1},
+    {"workspace_switch", tfwm_workspace_switch, 1},
+    {"workspace_next", tfwm_workspace_next, 0},
+    {"workspace_prev", tfwm_workspace_prev, 0},
+    {"workspace_swap_prev", tfwm_workspace_swap_prev, 0},
+    {"workspace_use_tiling", tfwm_workspace_use_tiling, 0},
+    {"workspace_use_floating", tfwm_workspace_use_floating, 0},
+    {"workspace_use_window", tfwm_workspace_use_window, 0},
 };
 
 #endif  // !TFWM_H